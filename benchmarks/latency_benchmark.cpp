@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+#include <backend.hpp>
+#include <log4tiny.hpp>
+
+// Latency of individual tinylog calls of a producer pinned to CPU 0, with records drained by an in-process backend
+// either sharing CPU 0 with the producer or running on CPU 1. Reports percentiles of call latency - the tail shows the
+// cost of the backend being scheduled on (or polluting caches of) the latency-critical core.
+
+namespace {
+
+class NullSink : public log4tiny::Sink {
+public:
+  void write(std::span<const uint8_t>) override {}
+
+  void flush() override {}
+};
+
+// Producer logs at a steady pace rather than flat out, as a latency-critical service would
+void wait_until(const std::chrono::steady_clock::time_point deadline) {
+  while (std::chrono::steady_clock::now() < deadline) {
+  }
+}
+
+void BM_TinylogLatency(benchmark::State &state) {
+  const bool shared_core = state.range(0) != 0;
+  if (not shared_core and sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+    state.SkipWithError("needs at least 2 CPUs");
+    return;
+  }
+  cpu_set_t producer_cpus{};
+  CPU_SET(0, &producer_cpus);
+  sched_setaffinity(0, sizeof(producer_cpus), &producer_cpus);
+
+  const std::string name = "/log4tiny_latency_benchmark_" + std::to_string(getpid());
+  log4tiny::BackendOptions options{};
+  options.thread.cpus = {shared_core ? 0U : 1U};
+  const auto transport = log4tiny::start_backend(name, std::make_unique<NullSink>(), options);
+  shm_unlink(name.c_str());
+
+  std::vector<int64_t> latencies{};
+  latencies.reserve(1U << 20);
+  int64_t value{0};
+  auto next = std::chrono::steady_clock::now();
+  for (auto _: state) {
+    next += std::chrono::microseconds(2);
+    wait_until(next);
+    const auto start = std::chrono::steady_clock::now();
+    tinylog("request %d took %u us", value, 42U)
+    latencies.push_back((std::chrono::steady_clock::now() - start).count());
+    ++value;
+  }
+
+  std::ranges::sort(latencies);
+  const auto percentile = [&latencies](const double fraction) {
+    return static_cast<double>(latencies[static_cast<size_t>(fraction * static_cast<double>(latencies.size() - 1))]);
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p99.9_ns"] = percentile(0.999);
+  state.counters["max_ns"] = static_cast<double>(latencies.back());
+}
+
+}
+
+BENCHMARK(BM_TinylogLatency)->ArgName("shared_core")->Arg(1)->Arg(0)->Iterations(500'000)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <log4tiny.hpp>
+#include <shm_transport.hpp>
+
+// Cost of a tinylog call with records drained by a consumer thread, as done by log4tiny_agent. Built once per producer
+// mode - per-thread SPSC rings, shared MPSC ring (LOG4TINY_MPSC_QUEUE) and per-CPU rings (LOG4TINY_PER_CPU_RINGS).
+
+namespace {
+
+class Consumer {
+public:
+  Consumer() {
+    const std::string name = "/log4tiny_benchmark_" + std::to_string(getpid());
+    // Both modes get the same amount of memory
+    source = log4tiny::shm::attach(name, 256, log4tiny::producer_mode == log4tiny::ProducerMode::shared_ring ? 64U << 20 : 256U << 10);
+    segment.emplace(*log4tiny::shm::Segment::open(name));
+    shm_unlink(name.c_str());
+    thread = std::thread([this] {
+      while (not stop.load(std::memory_order_relaxed)) {
+        if (log4tiny::shm::drain(*segment, [](std::span<const uint8_t>) {}) == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  ~Consumer() {
+    stop.store(true);
+    thread.join();
+  }
+
+private:
+  std::unique_ptr<log4tiny::shm::ShmRingSource> source;
+  std::optional<log4tiny::shm::Segment> segment;
+  std::atomic<bool> stop{false};
+  std::thread thread;
+};
+
+void BM_Tinylog(benchmark::State &state) {
+  uint64_t dropped_before = log4tiny::detail::thread_context().counters.dropped_records.load();
+  int64_t value{0};
+  for (auto _: state) {
+    tinylog("request %d took %u us", value, 42U)
+    ++value;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["dropped"] = benchmark::Counter(
+          static_cast<double>(log4tiny::detail::thread_context().counters.dropped_records.load() - dropped_before),
+          benchmark::Counter::kAvgThreads);
+}
+
+// Records published in batches of 16 (see RecordBatch) - one store of the write index per batch instead of per record
+void BM_TinylogBatch(benchmark::State &state) {
+  constexpr int64_t batch_size = 16;
+  uint64_t dropped_before = log4tiny::detail::thread_context().counters.dropped_records.load();
+  int64_t value{0};
+  for (auto _: state) {
+    const log4tiny::RecordBatch batch{};
+    for (int64_t record = 0; record < batch_size; ++record) {
+      tinylog("request %d took %u us", value, 42U)
+      ++value;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+  state.counters["dropped"] = benchmark::Counter(
+          static_cast<double>(log4tiny::detail::thread_context().counters.dropped_records.load() - dropped_before),
+          benchmark::Counter::kAvgThreads);
+}
+
+}
+
+BENCHMARK(BM_Tinylog)->Threads(1)->Threads(8)->Threads(32)->Threads(64)->UseRealTime();
+BENCHMARK(BM_TinylogBatch)->Threads(1)->Threads(8)->UseRealTime();
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  const Consumer consumer{};
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
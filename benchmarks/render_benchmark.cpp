@@ -0,0 +1,165 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <decoder.hpp>
+#include <json_output.hpp>
+#include <text_format.hpp>
+
+namespace {
+
+constexpr auto integer_specification = *log4tiny::parse_placeholder_specification("%d");
+constexpr auto padded_hexadecimal_specification = *log4tiny::parse_placeholder_specification("%08x");
+constexpr auto floating_specification = *log4tiny::parse_placeholder_specification("%.3f");
+constexpr auto general_specification = *log4tiny::parse_placeholder_specification("%g");
+
+template<typename T>
+void render_snprintf(benchmark::State &state, const char *format, const T value) {
+  std::string output;
+  char buffer[512];
+  for (auto _: state) {
+    output.clear();
+    const auto length = std::snprintf(buffer, sizeof(buffer), format, value);
+    output.append(buffer, static_cast<size_t>(length));
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_SignedIntegerText(benchmark::State &state) {
+  const auto specification = log4tiny::text::ResolvedSpecification::resolve(integer_specification);
+  std::string output;
+  int64_t value = -1234567;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::text::append_signed_integer(output, specification, value);
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_SignedIntegerSnprintf(benchmark::State &state) {
+  render_snprintf(state, "%ld", -1234567L);
+}
+
+void BM_HexadecimalText(benchmark::State &state) {
+  const auto specification = log4tiny::text::ResolvedSpecification::resolve(padded_hexadecimal_specification);
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::text::append_integer(output, specification, 0xBEEFU);
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_HexadecimalSnprintf(benchmark::State &state) {
+  render_snprintf(state, "%08x", 0xBEEFU);
+}
+
+void BM_FixedFloatingText(benchmark::State &state) {
+  const auto specification = log4tiny::text::ResolvedSpecification::resolve(floating_specification);
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::text::append_floating(output, specification, 3141.59265);
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_FixedFloatingSnprintf(benchmark::State &state) {
+  render_snprintf(state, "%.3f", 3141.59265);
+}
+
+void BM_GeneralFloatingText(benchmark::State &state) {
+  const auto specification = log4tiny::text::ResolvedSpecification::resolve(general_specification);
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::text::append_floating(output, specification, 0.000123456789);
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_GeneralFloatingSnprintf(benchmark::State &state) {
+  render_snprintf(state, "%g", 0.000123456789);
+}
+
+constexpr std::string_view message_format = "request %u from %s took %.3f ms, status %d";
+
+const std::vector<log4tiny::protocol::ArgumentValue> &message_arguments() {
+  using log4tiny::protocol::ArgumentType;
+  static const std::vector<log4tiny::protocol::ArgumentValue> arguments = [] {
+    std::vector<log4tiny::protocol::ArgumentValue> values(4);
+    values[0].type = ArgumentType::unsigned_int;
+    values[0].unsigned_int = 123456;
+    values[1].type = ArgumentType::string;
+    values[1].string = "10.0.0.1";
+    values[2].type = ArgumentType::floating;
+    values[2].floating = 12.75;
+    values[3].type = ArgumentType::signed_int;
+    values[3].signed_int = 200;
+    return values;
+  }();
+  return arguments;
+}
+
+void BM_RenderMessage(benchmark::State &state) {
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::decoder::render_message(output, message_format, message_arguments());
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_RenderProgram(benchmark::State &state) {
+  const auto program = log4tiny::decoder::RenderProgram::compile(message_format);
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    program.render(output, message_arguments());
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+void BM_JsonRecord(benchmark::State &state) {
+  const log4tiny::decoder::SiteInfo site{.file_hash = 0, .line = 42, .file = "src/server/request_handler.cpp",
+          .format = std::string{message_format}, .argument_types = {},
+          .program = log4tiny::decoder::RenderProgram::compile(message_format), .sampling_rate = 1,
+          .level = log4tiny::protocol::Level::info};
+  const log4tiny::protocol::RecordHeader header{.length = 0, .kind = log4tiny::protocol::RecordKind::log,
+          .reserved = 0, .site_id = 0, .thread_id = 3, .timestamp = 1'700'000'000'123'456'789};
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::json::append_record(output, header, site, message_arguments());
+    benchmark::DoNotOptimize(output.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * output.size()));
+}
+
+void BM_JsonEscapeString(benchmark::State &state) {
+  const std::string text(static_cast<size_t>(state.range(0)), 'a');
+  std::string output;
+  for (auto _: state) {
+    output.clear();
+    log4tiny::json::append_string(output, text);
+    benchmark::DoNotOptimize(output.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+}
+
+BENCHMARK(BM_SignedIntegerText);
+BENCHMARK(BM_SignedIntegerSnprintf);
+BENCHMARK(BM_HexadecimalText);
+BENCHMARK(BM_HexadecimalSnprintf);
+BENCHMARK(BM_FixedFloatingText);
+BENCHMARK(BM_FixedFloatingSnprintf);
+BENCHMARK(BM_GeneralFloatingText);
+BENCHMARK(BM_GeneralFloatingSnprintf);
+BENCHMARK(BM_RenderMessage);
+BENCHMARK(BM_RenderProgram);
+BENCHMARK(BM_JsonRecord);
+BENCHMARK(BM_JsonEscapeString)->Arg(16)->Arg(256);
+
+BENCHMARK_MAIN();
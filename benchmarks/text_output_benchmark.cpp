@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <log4tiny.hpp>
+
+// Synchronous text output compared to fprintf of the same line (including timestamp) to the same descriptor. fprintf
+// is flushed after every line, so that both variants issue one write per line.
+
+namespace {
+
+int open_null() {
+  return ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+}
+
+void BM_TextOutput(benchmark::State &state) {
+  const int fd = open_null();
+  log4tiny::set_text_output(fd);
+  const std::string name{"disk"};
+  unsigned usage{0};
+  for (auto _: state) {
+    tinylog("%s usage %3u%%, %.1f GiB free", name, usage++ % 100, 12.25)
+  }
+  log4tiny::set_text_output(-1);
+  ::close(fd);
+}
+
+void BM_Fprintf(benchmark::State &state) {
+  FILE *file = ::fdopen(open_null(), "w");
+  const std::string name{"disk"};
+  unsigned usage{0};
+  for (auto _: state) {
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    std::tm time{};
+    gmtime_r(&now.tv_sec, &time);
+    std::fprintf(file, "%04d-%02d-%02d %02d:%02d:%02d.%09ld [%u] %s:%d %s usage %3u%%, %.1f GiB free\n",
+                 time.tm_year + 1900, time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec,
+                 now.tv_nsec, 0U, __FILE__, __LINE__, name.c_str(), usage++ % 100, 12.25);
+    std::fflush(file);
+  }
+  std::fclose(file);
+}
+
+}
+
+BENCHMARK(BM_TextOutput)->Threads(1)->Threads(4);
+BENCHMARK(BM_Fprintf)->Threads(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <polling.hpp>
+#include <shm_transport.hpp>
+#include <sink.hpp>
+#include <statistics.hpp>
+#include <thread_options.hpp>
+
+namespace log4tiny {
+
+struct BackendOptions {
+  PollingOptions polling{};
+  ThreadOptions thread{.name = "log4tiny"};
+};
+
+// In-process counterpart of log4tiny_agent: thread draining the shared memory segment of this process into a sink.
+// Thread spins while records are flowing and sleeps on the futex of the segment when the process is quiet, so idle
+// logging costs no CPU. Sink is flushed whenever the thread stops spinning. Thread is configured according to options
+// before it starts draining - failure to apply them is not fatal and is reported by is_configured().
+class Backend {
+public:
+  Backend(shm::Segment segment, std::unique_ptr<Sink> sink, const BackendOptions &options = {})
+          : segment(std::move(segment)), sink(std::move(sink)), options(options) {
+    this->sink->set_write_counters(&counters);
+    thread = std::thread([this] { run(); });
+  }
+
+  Backend(const Backend &) = delete;
+
+  Backend &operator=(const Backend &) = delete;
+
+  // Drain what producers have written so far and stop
+  ~Backend() {
+    stop_requested.store(true, std::memory_order_relaxed);
+    futex_wake(segment.header()->consumer_sleeping);
+    thread.join();
+    // Sink outlives the counters
+    sink->set_write_counters(nullptr);
+  }
+
+  // Producer counters of this process together with counters of the backend
+  Statistics collect_statistics() const {
+    auto statistics = ::log4tiny::collect_statistics();
+    counters.add_to(statistics);
+    return statistics;
+  }
+
+  // Whether all thread options were applied. Waits until the thread has started
+  bool is_configured() const {
+    configured.wait(Configuration::pending);
+    return configured.load() == Configuration::applied;
+  }
+
+private:
+  enum class Configuration {
+    pending,
+    applied,
+    refused
+  };
+
+  void run() {
+    configured.store(configure_current_thread(options.thread) ? Configuration::applied : Configuration::refused);
+    configured.notify_all();
+    AdaptivePoller poller{segment.header()->consumer_sleeping, options.polling};
+    bool unflushed{false};
+    while (true) {
+      const bool stopping = stop_requested.load(std::memory_order_relaxed);
+      if (drain()) {
+        poller.reset();
+        unflushed = true;
+        continue;
+      }
+      if (stopping) {
+        break;
+      }
+      if (unflushed and not poller.is_spinning()) {
+        flush();
+        unflushed = false;
+      }
+      poller.idle([this] { return stop_requested.load(std::memory_order_relaxed) or shm::has_records(segment); });
+    }
+    if (unflushed) {
+      flush();
+    }
+  }
+
+  // Single drain pass, returns whether any records were found
+  bool drain() {
+    uint64_t records{0};
+    uint64_t latency_sum{0};
+    uint64_t max_latency{0};
+    const auto now = detail::timestamp_now();
+    const auto bytes = shm::drain(segment, [&](std::span<const uint8_t> record) {
+      uint64_t timestamp{0};
+      std::memcpy(&timestamp, record.data() + offsetof(protocol::RecordHeader, timestamp), sizeof(timestamp));
+      ++records;
+      // Records published after the clock was read carry later timestamps
+      const auto latency = now > timestamp ? now - timestamp : 0;
+      latency_sum += latency;
+      max_latency = std::max(max_latency, latency);
+      sink->write(record);
+    });
+    if (bytes == 0) {
+      return false;
+    }
+    counters.count_drain(records, bytes, latency_sum, max_latency);
+    return true;
+  }
+
+  // Time of writing out the batch is counted by the sink itself
+  void flush() {
+    sink->flush();
+  }
+
+  shm::Segment segment;
+  std::unique_ptr<Sink> sink;
+  BackendOptions options;
+  std::atomic<bool> stop_requested{false};
+  std::atomic<Configuration> configured{Configuration::pending};
+  detail::BackendCounters counters{};
+  std::thread thread;
+};
+
+// Create segment with given name (see shm::attach()) and drain it on a backend thread of this process. Destroying the
+// returned pair stops the backend first, after it has drained all records
+struct LocalTransport {
+  std::unique_ptr<shm::ShmRingSource> source;
+  std::unique_ptr<Backend> backend;
+};
+
+[[nodiscard]] inline LocalTransport start_backend(const std::string &name, std::unique_ptr<Sink> sink,
+                                                  const BackendOptions &options = {}) {
+  LocalTransport transport{};
+  transport.source = shm::attach(name);
+  auto segment = shm::Segment::open(name);
+  if (not segment) {
+    throw std::runtime_error("Cannot open segment " + name);
+  }
+  transport.backend = std::make_unique<Backend>(std::move(*segment), std::move(sink), options);
+  return transport;
+}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <protocol.hpp>
+#include <spsc_ring.hpp>
+
+namespace log4tiny {
+
+// Level of a tinylog call site, recorded in its site record. Plain tinylog records are always written. Debug records
+// (tinylog_debug) are kept encoded in a per-thread backtrace buffer and written only when the thread logs an error
+// record (tinylog_error), just ahead of it - so that the error comes with the debug records leading to it, while debug
+// logging costs no ring space otherwise.
+using Level = protocol::Level;
+
+namespace detail {
+
+inline constexpr size_t default_backtrace_records = 32;
+inline constexpr size_t default_backtrace_capacity = 16 * 1024;
+
+inline std::atomic<size_t> backtrace_records{default_backtrace_records};
+inline std::atomic<size_t> backtrace_capacity{default_backtrace_capacity};
+// Incremented on every change of the size, so that threads rebuild their buffers on their next debug record
+inline std::atomic<uint64_t> backtrace_generation{0};
+
+// Ring of the last debug records of a thread. Producer and consumer are the same thread, so the ring overwrites its
+// oldest records instead of rejecting new ones. Memory is allocated with the first debug record of the thread.
+class BacktraceBuffer {
+public:
+  // Reserve space for record of given (aligned) length written within given ring source epoch, dropping the oldest
+  // records to make room. Records of previous epoch are discarded, as their site records belong to the previous stream.
+  // Returns nullptr when backtrace is disabled or record is larger than the whole buffer
+  uint8_t *reserve(const size_t length, const uint64_t epoch) {
+    if (const auto generation = backtrace_generation.load(std::memory_order_relaxed); generation != built_generation) {
+      rebuild(generation);
+    }
+    if (epoch != records_epoch) {
+      clear();
+      records_epoch = epoch;
+    }
+    if (max_records == 0 or length > capacity) {
+      return nullptr;
+    }
+    while (records == max_records) {
+      drop_oldest();
+    }
+    while (true) {
+      if (auto *destination = ring.reserve(length); destination != nullptr) {
+        return destination;
+      }
+      if (records == 0) {
+        // Empty ring may still lack contiguous space after its write position
+        clear();
+      } else {
+        drop_oldest();
+      }
+    }
+  }
+
+  void commit(uint8_t *record, const size_t length) {
+    ring.commit(record, length);
+    ++records;
+  }
+
+  // Pass records of given epoch to function, oldest first, and empty the buffer
+  template<typename Function>
+  void drain(const uint64_t epoch, Function &&function) {
+    if (records != 0 and epoch == records_epoch) {
+      for (auto readable = ring.readable(); not readable.empty(); readable = ring.readable()) {
+        protocol::for_each_record(readable, function);
+        ring.release(readable.size());
+      }
+    }
+    clear();
+  }
+
+  size_t get_records() const {
+    return records;
+  }
+
+private:
+  void rebuild(const uint64_t generation) {
+    built_generation = generation;
+    max_records = backtrace_records.load(std::memory_order_relaxed);
+    capacity = std::bit_ceil(std::max(backtrace_capacity.load(std::memory_order_relaxed), protocol::record_alignment));
+    data = max_records != 0 ? std::make_unique<uint8_t[]>(capacity) : nullptr;
+    clear();
+  }
+
+  void drop_oldest() {
+    // First readable record is complete, records are never split at the end of data area
+    const auto readable = ring.readable();
+    uint32_t length;
+    protocol::RecordKind kind;
+    std::memcpy(&length, readable.data() + offsetof(protocol::RecordHeader, length), sizeof(length));
+    std::memcpy(&kind, readable.data() + offsetof(protocol::RecordHeader, kind), sizeof(kind));
+    ring.release(length);
+    if (kind != protocol::RecordKind::padding) {
+      --records;
+    }
+  }
+
+  void clear() {
+    control.write_index.store(0, std::memory_order_relaxed);
+    control.read_index.store(0, std::memory_order_relaxed);
+    control.cached_write_index.store(0, std::memory_order_relaxed);
+    ring = data != nullptr ? SpscRing{&control, data.get(), capacity} : SpscRing{};
+    records = 0;
+  }
+
+  RingControl control{};
+  std::unique_ptr<uint8_t[]> data{};
+  SpscRing ring{};
+  size_t capacity{0};
+  size_t max_records{0};
+  size_t records{0};
+  uint64_t records_epoch{0};
+  uint64_t built_generation{static_cast<uint64_t>(-1)};
+};
+
+}
+
+// Keep at most given number of debug records per thread in a buffer of given bytes (rounded up to a power of two).
+// Zero records disables the backtrace - debug records are then dropped. Threads apply the size with their next debug
+// record, discarding records buffered so far
+inline void set_backtrace_size(const size_t records, const size_t capacity = detail::default_backtrace_capacity) {
+  detail::backtrace_records.store(records, std::memory_order_relaxed);
+  detail::backtrace_capacity.store(capacity, std::memory_order_relaxed);
+  detail::backtrace_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
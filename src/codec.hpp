@@ -0,0 +1,103 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+namespace log4tiny {
+
+// Extension point for logging user types (prices, ids, small structures) without formatting them at the call site.
+// Type is enabled by specializing codec with a name - its values are then encoded by copying their bytes, so the type
+// has to be trivially copyable, and matched by "%s" placeholders. The name is stored once per call site. Optional
+// render() turns the value back into text: in the producer (text output) directly, in the decoder once the type is
+// registered under its name with register_codec<T>(). Values without renderer are rendered as their bytes in hex.
+//
+//   template<>
+//   struct log4tiny::codec<Price> {
+//     static constexpr std::string_view name = "Price";
+//
+//     static void render(std::string &output, const Price &price) {
+//       output += std::to_string(price.units) + "." + std::to_string(price.nanos);
+//     }
+//   };
+template<typename T>
+struct codec {
+};
+
+template<typename T>
+concept CodecArgument = std::is_trivially_copyable_v<T> and requires {
+  { codec<T>::name } -> std::convertible_to<std::string_view>;
+};
+
+// Renders encoded bytes of a value as text
+using CodecRenderer = void (*)(std::string &output, std::span<const uint8_t> bytes);
+
+inline void append_codec_bytes(std::string &output, std::span<const uint8_t> bytes) {
+  output.push_back('<');
+  for (const auto byte: bytes) {
+    output.push_back("0123456789abcdef"[byte >> 4]);
+    output.push_back("0123456789abcdef"[byte & 0xF]);
+  }
+  output.push_back('>');
+}
+
+// Renderer of T, nullptr when its codec has no render()
+template<CodecArgument T>
+constexpr CodecRenderer codec_renderer() {
+  if constexpr (requires(std::string &output, const T &value) { codec<T>::render(output, value); }) {
+    return [](std::string &output, std::span<const uint8_t> bytes) {
+      // Size differs when the decoder was built with another version of the type than the producer
+      if (bytes.size() != sizeof(T)) {
+        append_codec_bytes(output, bytes);
+        return;
+      }
+      alignas(T) unsigned char storage[sizeof(T)];
+      std::memcpy(storage, bytes.data(), sizeof(T));
+      codec<T>::render(output, *std::launder(reinterpret_cast<const T *>(storage)));
+    };
+  } else {
+    return nullptr;
+  }
+}
+
+namespace detail {
+
+struct CodecRegistry {
+  std::mutex mutex{};
+  std::unordered_map<std::string, CodecRenderer> renderers{};
+};
+
+inline CodecRegistry &codec_registry() {
+  static CodecRegistry registry{};
+  return registry;
+}
+
+}
+
+inline void register_codec_renderer(const std::string_view name, const CodecRenderer renderer) {
+  auto &registry = detail::codec_registry();
+  const std::lock_guard lock{registry.mutex};
+  registry.renderers.insert_or_assign(std::string{name}, renderer);
+}
+
+// Make decoder render values of T - to be called before site records are read, renderers are looked up once per site
+template<CodecArgument T>
+void register_codec() {
+  register_codec_renderer(codec<T>::name, codec_renderer<T>());
+}
+
+inline CodecRenderer find_codec_renderer(const std::string_view name) {
+  auto &registry = detail::codec_registry();
+  const std::lock_guard lock{registry.mutex};
+  const auto renderer = registry.renderers.find(std::string{name});
+  return renderer != registry.renderers.end() ? renderer->second : nullptr;
+}
+
+}
@@ -0,0 +1,469 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <decoder.hpp>
+#include <sink.hpp>
+
+namespace log4tiny::columns {
+
+// Export of decoded records into column files, one set per call site, for loading into columnar engines. Export
+// directory holds a directory per call site, named site_<file hash>_<line> (with _<n> appended when the log holds
+// differing definitions of the same site, e.g. from several builds):
+//
+//   schema.txt      - text, one "<key> <value>" per line: "file <path>", "line <line>", "format <format>" (with
+//                     backslashes and newlines escaped as in C), "rows <count>" and "column <name> <type>" for every
+//                     column, in order of the record
+//   <name>.col      - ColumnHeader followed by row_count values of the column type, native (little-endian) byte order
+//   <name>.str      - string and bytes columns only: concatenated bytes of all values, .col file then holds row_count
+//                     uint64 end offsets of values in it (value of row i spans from end offset of row i - 1, or 0, to
+//                     its own)
+//
+// Values start right after the 16-byte header, so a mapped .col file is an array of values (8-byte aligned for 64-bit
+// types). Every site has columns timestamp (uint64, nanoseconds since epoch) and thread (uint32), followed by a column
+// per placeholder, named after the placeholder (see RenderProgram::get_field_names()). Column type follows the type
+// the argument was encoded with, which is what the decoder knows reliably - placeholder only decides rendering. Values
+// of user types (see codec) are exported as their encoded bytes, type of such column is "bytes:<codec name>".
+
+inline constexpr uint32_t column_magic = 0x4354344CU; // "L4TC"
+inline constexpr uint16_t column_version = 1;
+
+enum class ColumnType : uint8_t {
+  int64 = 0,
+  uint64 = 1,
+  float64 = 2,
+  char8 = 3,
+  string = 4,
+  uint32 = 5,
+  bytes = 6
+};
+
+struct ColumnHeader {
+  uint32_t magic;
+  uint16_t version;
+  ColumnType type;
+  uint8_t reserved;
+  // Written when the column is finished, until then zero
+  uint64_t row_count;
+};
+
+static_assert(sizeof(ColumnHeader) == 16);
+
+inline ColumnType column_type_of(const protocol::ArgumentType type) {
+  switch (type) {
+    case protocol::ArgumentType::signed_int:
+      return ColumnType::int64;
+    case protocol::ArgumentType::xor_floating:
+    case protocol::ArgumentType::floating:
+      return ColumnType::float64;
+    case protocol::ArgumentType::character:
+      return ColumnType::char8;
+    case protocol::ArgumentType::string:
+      return ColumnType::string;
+    case protocol::ArgumentType::user:
+      return ColumnType::bytes;
+    default:
+      return ColumnType::uint64;
+  }
+}
+
+inline std::string_view type_name(const ColumnType type) {
+  switch (type) {
+    case ColumnType::int64:
+      return "int64";
+    case ColumnType::uint64:
+      return "uint64";
+    case ColumnType::float64:
+      return "float64";
+    case ColumnType::char8:
+      return "char8";
+    case ColumnType::string:
+      return "string";
+    case ColumnType::uint32:
+      return "uint32";
+    case ColumnType::bytes:
+      return "bytes";
+  }
+  return "unknown";
+}
+
+inline constexpr size_t default_max_open_files = 256;
+
+class ColumnFile;
+
+// Least recently used set of open column files. A log may hold thousands of sites with several columns each - more
+// than the limit of open descriptors - so files beyond given count are closed (with their write buffers released) and
+// reopened for appending once written again
+class FilePool {
+public:
+  explicit FilePool(const size_t max_open_files = default_max_open_files)
+          : max_open_files(std::max<size_t>(max_open_files, 1)) {}
+
+  FilePool(const FilePool &) = delete;
+
+  FilePool &operator=(const FilePool &) = delete;
+
+  // Make given file open and the most recently used one, closing the least recently used file when needed
+  inline void use(ColumnFile &file);
+
+  inline void remove(ColumnFile &file);
+
+  size_t get_open_files() const {
+    return open_files.size();
+  }
+
+private:
+  size_t max_open_files;
+  std::list<ColumnFile *> open_files{};
+};
+
+// Output file with a write buffer of its own, open only while in the pool of open files
+class ColumnFile {
+public:
+  ColumnFile(std::string path, FilePool &pool) : path(std::move(path)), pool(pool) {
+    // Created (or truncated) right away, so that it exists even if nothing is written to it
+    pool.use(*this);
+  }
+
+  ColumnFile(const ColumnFile &) = delete;
+
+  ColumnFile &operator=(const ColumnFile &) = delete;
+
+  ~ColumnFile() {
+    pool.remove(*this);
+  }
+
+  void append(const void *bytes, const size_t length) {
+    pool.use(*this);
+    if (buffer.size() + length > buffer_size) {
+      flush();
+    }
+    if (length > buffer_size) {
+      write_all(fd, {static_cast<const uint8_t *>(bytes), length});
+      return;
+    }
+    buffer.insert(buffer.end(), static_cast<const uint8_t *>(bytes), static_cast<const uint8_t *>(bytes) + length);
+  }
+
+  void flush() {
+    if (fd >= 0) {
+      write_all(fd, buffer);
+      buffer.clear();
+    }
+  }
+
+  // Overwrite bytes written before. Done through a descriptor of its own, as pwrite() ignores the offset on files open
+  // for appending
+  void write_at(const uint64_t offset, const void *bytes, const size_t length) {
+    flush();
+    const int write_fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (write_fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    const auto written = ::pwrite(write_fd, bytes, length, static_cast<off_t>(offset));
+    const int error = errno;
+    ::close(write_fd);
+    if (written != static_cast<ssize_t>(length)) {
+      throw std::system_error(error, std::generic_category(), "pwrite " + path);
+    }
+  }
+
+private:
+  friend class FilePool;
+
+  static constexpr size_t buffer_size = 64 * 1024;
+
+  // First opening creates the file, later ones append to it
+  void open() {
+    fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC | (created ? O_APPEND : O_CREAT | O_TRUNC), 0644);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    created = true;
+    buffer.reserve(buffer_size);
+  }
+
+  void close() {
+    flush();
+    ::close(fd);
+    fd = -1;
+    buffer = {};
+  }
+
+  std::string path;
+  FilePool &pool;
+  int fd{-1};
+  bool created{false};
+  std::vector<uint8_t> buffer{};
+  // Position in the pool while open
+  std::list<ColumnFile *>::iterator position{};
+};
+
+void FilePool::use(ColumnFile &file) {
+  if (file.fd >= 0) {
+    if (file.position != open_files.begin()) {
+      open_files.splice(open_files.begin(), open_files, file.position);
+    }
+    return;
+  }
+  if (open_files.size() == max_open_files) {
+    open_files.back()->close();
+    open_files.pop_back();
+  }
+  file.open();
+  file.position = open_files.insert(open_files.begin(), &file);
+}
+
+// Close file without writing out its buffer
+void FilePool::remove(ColumnFile &file) {
+  if (file.fd >= 0) {
+    ::close(file.fd);
+    file.fd = -1;
+    open_files.erase(file.position);
+  }
+}
+
+class ColumnWriter {
+public:
+  ColumnWriter(const std::string &directory, const std::string &name, const ColumnType type, FilePool &pool)
+          : type(type), values(directory + "/" + name + ".col", pool) {
+    if (type == ColumnType::string or type == ColumnType::bytes) {
+      strings = std::make_unique<ColumnFile>(directory + "/" + name + ".str", pool);
+    }
+    const ColumnHeader header{.magic = column_magic, .version = column_version, .type = type, .reserved = 0,
+            .row_count = 0};
+    values.append(&header, sizeof(header));
+  }
+
+  // Value is converted to the type of the column, as in text rendering (see text::as_signed())
+  void append(const protocol::ArgumentValue &value) {
+    switch (type) {
+      case ColumnType::int64:
+        append_fixed(text::as_signed(value));
+        break;
+      case ColumnType::uint64:
+        append_fixed(text::as_unsigned(value));
+        break;
+      case ColumnType::float64:
+        append_fixed(text::as_double(value));
+        break;
+      case ColumnType::char8:
+        append_fixed(static_cast<char>(text::as_signed(value)));
+        break;
+      case ColumnType::uint32:
+        append_fixed(static_cast<uint32_t>(text::as_unsigned(value)));
+        break;
+      case ColumnType::string:
+      case ColumnType::bytes:
+        append_string(value.type == protocol::ArgumentType::string or value.type == protocol::ArgumentType::user
+                      ? value.string : std::string_view{});
+        break;
+    }
+  }
+
+  template<typename T>
+  void append_fixed(const T value) {
+    values.append(&value, sizeof(value));
+    ++rows;
+  }
+
+  void append_string(const std::string_view value) {
+    strings->append(value.data(), value.size());
+    string_bytes += value.size();
+    append_fixed(string_bytes);
+  }
+
+  // Write out buffers and row count
+  void finish() {
+    values.flush();
+    if (strings) {
+      strings->flush();
+    }
+    values.write_at(offsetof(ColumnHeader, row_count), &rows, sizeof(rows));
+  }
+
+  ColumnType get_type() const {
+    return type;
+  }
+
+  uint64_t get_rows() const {
+    return rows;
+  }
+
+private:
+  ColumnType type;
+  ColumnFile values;
+  std::unique_ptr<ColumnFile> strings{};
+  uint64_t rows{0};
+  uint64_t string_bytes{0};
+};
+
+inline void make_directory(const std::string &path) {
+  if (::mkdir(path.c_str(), 0755) != 0 and errno != EEXIST) {
+    throw std::system_error(errno, std::generic_category(), "mkdir " + path);
+  }
+}
+
+// Columns of a single call site definition
+class SiteColumns {
+public:
+  SiteColumns(std::string directory, const decoder::SiteInfo &site, FilePool &pool)
+          : directory(std::move(directory)), site(site), pool(pool) {
+    make_directory(this->directory);
+    add_column("timestamp", ColumnType::uint64, 0);
+    add_column("thread", ColumnType::uint32, 0);
+    size_t field{0};
+    for (const auto &fragment: site.program.get_fragments()) {
+      if (not fragment.placeholder) {
+        continue;
+      }
+      // Value of the placeholder follows its '*' width and precision. Placeholders without argument are not exported
+      const auto argument = fragment.first_argument + fragment.placeholder->argument_count() - 1;
+      const auto &name = site.program.get_field_names()[field++];
+      if (argument >= site.argument_types.size()) {
+        continue;
+      }
+      const auto type = column_type_of(site.argument_types[argument]);
+      if (type == ColumnType::bytes) {
+        const auto user_argument = std::ranges::count(site.argument_types.begin(),
+                                                      site.argument_types.begin() + static_cast<ptrdiff_t>(argument),
+                                                      protocol::ArgumentType::user);
+        add_column(name, type, argument, static_cast<size_t>(user_argument) < site.codecs.size()
+                                         ? site.codecs[static_cast<size_t>(user_argument)].name : std::string{});
+      } else {
+        add_column(name, type, argument);
+      }
+    }
+  }
+
+  void add(const protocol::RecordHeader &header, std::span<const protocol::ArgumentValue> arguments) {
+    columns[0].writer->append_fixed(header.timestamp);
+    columns[1].writer->append_fixed(header.thread_id);
+    for (size_t column = 2; column < columns.size(); ++column) {
+      columns[column].writer->append(arguments[columns[column].argument]);
+    }
+  }
+
+  void finish() {
+    for (auto &column: columns) {
+      column.writer->finish();
+    }
+    ColumnFile schema{directory + "/schema.txt", pool};
+    std::string text = "file " + site.file + "\nline " + std::to_string(site.line) + "\nformat ";
+    for (const char character: site.format) {
+      text += character == '\\' ? "\\\\" : character == '\n' ? "\\n" : std::string(1, character);
+    }
+    text += "\nrows " + std::to_string(columns[0].writer->get_rows()) + "\n";
+    for (const auto &column: columns) {
+      text += "column " + column.name + " " + std::string{type_name(column.writer->get_type())};
+      text += column.codec.empty() ? "\n" : ":" + column.codec + "\n";
+    }
+    schema.append(text.data(), text.size());
+    schema.flush();
+  }
+
+  bool is_definition_of(const decoder::SiteInfo &other) const {
+    return other.file_hash == site.file_hash and other.line == site.line and other.format == site.format and
+           other.argument_types == site.argument_types and other.codecs == site.codecs;
+  }
+
+private:
+  struct Column {
+    std::string name;
+    size_t argument;
+    std::unique_ptr<ColumnWriter> writer;
+    // Codec name of bytes column
+    std::string codec;
+  };
+
+  void add_column(std::string name, const ColumnType type, const size_t argument, std::string codec = {}) {
+    // Names are identifiers, but a placeholder may repeat a name or be named like the record columns
+    while (std::ranges::any_of(columns, [&name](const Column &column) { return column.name == name; })) {
+      name += "_";
+    }
+    auto writer = std::make_unique<ColumnWriter>(directory, name, type, pool);
+    columns.push_back(Column{.name = std::move(name), .argument = argument, .writer = std::move(writer),
+            .codec = std::move(codec)});
+  }
+
+  std::string directory;
+  decoder::SiteInfo site;
+  FilePool &pool;
+  std::vector<Column> columns{};
+};
+
+// Exporter of records of all sites of a log into given directory. Like RecordFilter, it caches per site id and has to
+// be told when the id gets redefined (see forget_site()). At most given number of column files is kept open at a time
+class ColumnExporter {
+public:
+  explicit ColumnExporter(std::string directory, const size_t max_open_files = default_max_open_files)
+          : directory(std::move(directory)), pool(max_open_files) {
+    make_directory(this->directory);
+  }
+
+  ColumnExporter(const ColumnExporter &) = delete;
+
+  ColumnExporter &operator=(const ColumnExporter &) = delete;
+
+  void add(const protocol::RecordHeader &header, const decoder::SiteInfo &site,
+           std::span<const protocol::ArgumentValue> arguments) {
+    auto cached = site_columns.find(header.site_id);
+    if (cached == site_columns.end()) {
+      cached = site_columns.emplace(header.site_id, &find_or_create(site)).first;
+    }
+    cached->second->add(header, arguments);
+  }
+
+  void forget_site(const uint32_t site_id) {
+    site_columns.erase(site_id);
+  }
+
+  // Write out all columns and schemas, to be called once all records are added
+  void finish() {
+    for (auto &[key, definitions]: sites) {
+      for (auto &definition: definitions) {
+        definition->finish();
+      }
+    }
+  }
+
+private:
+  SiteColumns &find_or_create(const decoder::SiteInfo &site) {
+    auto &definitions = sites[{site.file_hash, site.line}];
+    for (auto &definition: definitions) {
+      if (definition->is_definition_of(site)) {
+        return *definition;
+      }
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "site_%08x_%u", site.file_hash, site.line);
+    std::string path = directory + "/" + name;
+    if (not definitions.empty()) {
+      path += "_" + std::to_string(definitions.size());
+    }
+    return *definitions.emplace_back(std::make_unique<SiteColumns>(std::move(path), site, pool));
+  }
+
+  std::string directory;
+  // Declared before the sites, so that it outlives their files
+  FilePool pool;
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<std::unique_ptr<SiteColumns>>> sites{};
+  std::unordered_map<uint32_t, SiteColumns *> site_columns{};
+};
+
+}
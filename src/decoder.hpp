@@ -0,0 +1,548 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <file_index.hpp>
+#include <float_codec.hpp>
+#include <format_parser.hpp>
+#include <protocol.hpp>
+#include <site_counters.hpp>
+#include <text_format.hpp>
+
+namespace log4tiny::decoder {
+
+using text::as_double;
+using text::as_signed;
+using text::as_unsigned;
+using text::format_timestamp;
+using text::render_fragments;
+using text::render_placeholder;
+
+// Turn value rendered at given offset of output (up to its end) into value of a structured field: kept as is when it is
+// a single word, otherwise put in double quotes with '"', '\\' and control characters escaped
+inline void quote_field_value(std::string &output, const size_t value_offset) {
+  const std::string_view value{output.data() + value_offset, output.size() - value_offset};
+  if (not value.empty() and std::ranges::none_of(value, [](const char character) {
+    return character == ' ' or character == '"' or character == '=' or character == '\\' or
+           static_cast<unsigned char>(character) < 0x20;
+  })) {
+    return;
+  }
+  const std::string raw{value};
+  output.resize(value_offset);
+  output.push_back('"');
+  for (const char character: raw) {
+    switch (character) {
+      case '"':
+      case '\\':
+        output.push_back('\\');
+        output.push_back(character);
+        break;
+      case '\n':
+        output += "\\n";
+        break;
+      case '\t':
+        output += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20) {
+          output += "\\x";
+          output.push_back("0123456789abcdef"[character >> 4]);
+          output.push_back("0123456789abcdef"[character & 0xF]);
+        } else {
+          output.push_back(character);
+        }
+    }
+  }
+  output.push_back('"');
+}
+
+// Format string compiled to a flat list of fragments, each being a literal followed by (optionally) a placeholder.
+// Format is split once per call site, so rendering a record is a loop over fragments without any format parsing
+class RenderProgram {
+public:
+  static RenderProgram compile(const std::string_view format) {
+    RenderProgram program{};
+    program.format = format;
+    program.fragments = split_format(format);
+    for (const auto &fragment: program.fragments) {
+      if (fragment.placeholder) {
+        program.argument_count = fragment.first_argument + fragment.placeholder->argument_count();
+        // Unnamed placeholders are named by index of their value, as arguments in record filter predicates
+        const auto name = fragment.get_name(program.format);
+        program.field_names.push_back(not name.empty() ? std::string{name}
+                                                       : "arg" + std::to_string(program.argument_count - 1));
+      }
+    }
+    return program;
+  }
+
+  void render(std::string &output, std::span<const protocol::ArgumentValue> arguments) const {
+    render_fragments(output, format, fragments, arguments);
+  }
+
+  // Render placeholders as space separated "name=value" fields (see quote_field_value()), named after the format
+  // (e.g. "%{order_id}u") - structured alternative to render()
+  void render_fields(std::string &output, std::span<const protocol::ArgumentValue> arguments) const {
+    size_t field{0};
+    for (const auto &fragment: fragments) {
+      if (not fragment.placeholder) {
+        continue;
+      }
+      if (field != 0) {
+        output.push_back(' ');
+      }
+      output += field_names[field++];
+      output.push_back('=');
+      const auto value_offset = output.size();
+      const auto count = fragment.placeholder->argument_count();
+      if (fragment.first_argument + count <= arguments.size()) {
+        render_placeholder(output, *fragment.placeholder, arguments.subspan(fragment.first_argument, count));
+      } else {
+        output += "<missing>";
+      }
+      quote_field_value(output, value_offset);
+    }
+  }
+
+  const std::vector<FormatFragment> &get_fragments() const {
+    return fragments;
+  }
+
+  size_t get_argument_count() const {
+    return argument_count;
+  }
+
+  // Name of every placeholder, in order of the format
+  const std::vector<std::string> &get_field_names() const {
+    return field_names;
+  }
+
+private:
+  std::string format{};
+  std::vector<FormatFragment> fragments{};
+  size_t argument_count{0};
+  std::vector<std::string> field_names{};
+};
+
+// Render format string with decoded arguments. Compiles the format on every call - when rendering records, use program
+// of the site instead
+inline void render_message(std::string &output, const std::string_view format,
+                           std::span<const protocol::ArgumentValue> arguments) {
+  RenderProgram::compile(format).render(output, arguments);
+}
+
+// User type of an argument (see codec), with renderer registered for it in the decoder, if any
+struct ArgumentCodec {
+  std::string name;
+  uint16_t size;
+  CodecRenderer renderer;
+
+  bool operator==(const ArgumentCodec &other) const {
+    return name == other.name and size == other.size;
+  }
+};
+
+struct SiteInfo {
+  uint32_t file_hash;
+  uint32_t line;
+  std::string file;
+  std::string format;
+  std::vector<protocol::ArgumentType> argument_types;
+  RenderProgram program;
+  // Site logged 1 in sampling_rate calls - its record counts have to be multiplied by it to estimate the real volume
+  uint32_t sampling_rate;
+  protocol::Level level;
+  // One per argument of user type, in order of arguments
+  std::vector<ArgumentCodec> codecs{};
+  // Whether argument is XOR coded (see protocol::XorStreamPrefix), empty when site has no such arguments. XOR coded
+  // arguments are listed as floating in argument_types, as that is what they decode to
+  std::vector<bool> xor_coded{};
+};
+
+inline std::optional<SiteInfo> parse_site_record(std::span<const uint8_t> record) {
+  if (record.size() < sizeof(protocol::RecordHeader) + sizeof(protocol::SiteDescriptor)) {
+    return std::nullopt;
+  }
+  protocol::SiteDescriptor descriptor{};
+  std::memcpy(&descriptor, record.data() + sizeof(protocol::RecordHeader), sizeof(descriptor));
+  const auto variable_part = record.subspan(sizeof(protocol::RecordHeader) + sizeof(descriptor));
+  if (variable_part.size() < static_cast<size_t>(descriptor.argument_count) + descriptor.file_length +
+                              descriptor.format_length + descriptor.codec_length) {
+    return std::nullopt;
+  }
+  const auto *types = reinterpret_cast<const protocol::ArgumentType *>(variable_part.data());
+  const auto *file = reinterpret_cast<const char *>(variable_part.data() + descriptor.argument_count);
+  const std::string_view format{file + descriptor.file_length, descriptor.format_length};
+  SiteInfo site{.file_hash = descriptor.file_hash, .line = descriptor.line,
+          .file = std::string{file, descriptor.file_length}, .format = std::string{format},
+          .argument_types = std::vector<protocol::ArgumentType>{types, types + descriptor.argument_count},
+          .program = RenderProgram::compile(format), .sampling_rate = std::max(descriptor.sampling_rate, 1U),
+          .level = descriptor.level};
+  if (std::ranges::find(site.argument_types, protocol::ArgumentType::xor_floating) != site.argument_types.end()) {
+    for (auto &type: site.argument_types) {
+      site.xor_coded.push_back(type == protocol::ArgumentType::xor_floating);
+      if (type == protocol::ArgumentType::xor_floating) {
+        type = protocol::ArgumentType::floating;
+      }
+    }
+  }
+
+  auto codec_descriptions = variable_part.subspan(descriptor.argument_count + descriptor.file_length +
+                                                  descriptor.format_length, descriptor.codec_length);
+  for (const auto type: site.argument_types) {
+    if (type != protocol::ArgumentType::user) {
+      continue;
+    }
+    uint16_t description[2];
+    if (codec_descriptions.size() < sizeof(description)) {
+      return std::nullopt;
+    }
+    std::memcpy(description, codec_descriptions.data(), sizeof(description));
+    if (codec_descriptions.size() < sizeof(description) + description[1]) {
+      return std::nullopt;
+    }
+    std::string name{reinterpret_cast<const char *>(codec_descriptions.data() + sizeof(description)), description[1]};
+    const auto renderer = find_codec_renderer(name);
+    site.codecs.push_back(ArgumentCodec{.name = std::move(name), .size = description[0], .renderer = renderer});
+    codec_descriptions = codec_descriptions.subspan(sizeof(description) + description[1]);
+  }
+  return site;
+}
+
+// Site definitions seen so far, together with render programs compiled from their formats. Definition of given id is
+// replaced when a new one appears, which happens when a log contains streams of several runs of the producer
+class SiteRegistry {
+public:
+  void define(std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (auto site = parse_site_record(record)) {
+      sites.insert_or_assign(header.site_id, std::move(*site));
+    }
+  }
+
+  const SiteInfo *find(const uint32_t site_id) const {
+    const auto site = sites.find(site_id);
+    return site != sites.end() ? &site->second : nullptr;
+  }
+
+  const std::unordered_map<uint32_t, SiteInfo> &get_sites() const {
+    return sites;
+  }
+
+private:
+  std::unordered_map<uint32_t, SiteInfo> sites{};
+};
+
+// Records and bytes per call site, for a "top talkers" report of a log (see top_talkers()). Sites are keyed by file hash
+// and line, so that volume of a site is summed over all runs of the producer in the log
+class VolumeCounter {
+public:
+  void add(const SiteInfo &site, const size_t record_length) {
+    const auto key = static_cast<uint64_t>(site.file_hash) << 32 | site.line;
+    auto [volume, inserted] = volumes.try_emplace(key);
+    if (inserted) {
+      volume->second = SiteVolume{.file_hash = site.file_hash, .line = site.line, .file = site.file,
+              .format = site.format, .records = 0, .bytes = 0, .sampling_rate = site.sampling_rate};
+    }
+    ++volume->second.records;
+    volume->second.bytes += record_length;
+  }
+
+  std::vector<SiteVolume> get_volumes() const {
+    std::vector<SiteVolume> result{};
+    for (const auto &[key, volume]: volumes) {
+      result.push_back(volume);
+    }
+    return result;
+  }
+
+private:
+  std::unordered_map<uint64_t, SiteVolume> volumes{};
+};
+
+// Offset of the first argument in log records of the site
+inline size_t arguments_offset(const SiteInfo &site) {
+  return sizeof(protocol::RecordHeader) + (site.xor_coded.empty() ? 0 : sizeof(protocol::XorStreamPrefix));
+}
+
+// Bytes taken by argument of given index stored at cursor, nullopt when they do not fit into left bytes of the record.
+// XOR coded arguments take no bytes of their own. User argument counts arguments of user type passed so far
+inline std::optional<size_t> stored_argument_length(const SiteInfo &site, const size_t argument, const uint8_t *cursor,
+                                                    const size_t left, size_t &user_argument) {
+  const auto type = site.argument_types[argument];
+  size_t length = type == protocol::ArgumentType::character ? 1 : sizeof(uint64_t);
+  if (not site.xor_coded.empty() and site.xor_coded[argument]) {
+    length = 0;
+  } else if (type == protocol::ArgumentType::string) {
+    uint32_t string_length{0};
+    std::memcpy(&string_length, cursor, std::min(left, sizeof(string_length)));
+    length = sizeof(string_length) + string_length;
+  } else if (type == protocol::ArgumentType::user) {
+    if (user_argument == site.codecs.size()) {
+      return std::nullopt;
+    }
+    length = site.codecs[user_argument++].size;
+  }
+  if (length > left) {
+    return std::nullopt;
+  }
+  return length;
+}
+
+// Read arguments of the record according to types stored in site definition. Arguments are stored in given vector, so
+// that its storage can be reused between records. Values of XOR coded arguments are not stored in the record on their
+// own and are taken from xor_values (see FloatStreams), in order of arguments
+inline bool decode_arguments(const SiteInfo &site, std::span<const uint8_t> record,
+                             std::vector<protocol::ArgumentValue> &arguments,
+                             std::span<const double> xor_values = {}) {
+  arguments.clear();
+  if (record.size() < arguments_offset(site)) {
+    return false;
+  }
+  const uint8_t *cursor = record.data() + arguments_offset(site);
+  const uint8_t *end = record.data() + record.size();
+  size_t user_argument{0};
+  size_t xor_value{0};
+  for (size_t argument = 0; argument < site.argument_types.size(); ++argument) {
+    if (not stored_argument_length(site, argument, cursor, static_cast<size_t>(end - cursor), user_argument)) {
+      return false;
+    }
+    const auto type = site.argument_types[argument];
+    if (not site.xor_coded.empty() and site.xor_coded[argument]) {
+      if (xor_value == xor_values.size()) {
+        return false;
+      }
+      arguments.push_back(protocol::ArgumentValue{.type = type, .floating = xor_values[xor_value++], .string = {}});
+    } else if (type == protocol::ArgumentType::user) {
+      const auto &codec = site.codecs[user_argument - 1];
+      arguments.push_back(protocol::decode_user_argument(cursor, codec.size, codec.renderer));
+    } else {
+      arguments.push_back(protocol::decode_argument(type, cursor));
+    }
+  }
+  return true;
+}
+
+inline std::optional<std::vector<protocol::ArgumentValue>>
+decode_arguments(const SiteInfo &site, std::span<const uint8_t> record) {
+  std::vector<protocol::ArgumentValue> arguments{};
+  if (not decode_arguments(site, record, arguments)) {
+    return std::nullopt;
+  }
+  return arguments;
+}
+
+// Decoder side of XOR coded floating point arguments (see protocol::XorStreamPrefix): state of every stream of records,
+// i.e. records of a site written by a thread to a ring. Records of a stream have to be passed in the order they were
+// written, which holds for a log written by a single consumer, including records that are not printed (e.g. before the
+// selected time range). When a record of the stream is missing, e.g. within a chunk skipped thanks to the index, values
+// of its following records are unknown until the next key record.
+class FloatStreams {
+public:
+  // Decode XOR coded values of a log record of given site, in order of arguments. Returns false when they cannot be
+  // decoded - record of the stream is missing or the record is corrupted
+  bool decode(const protocol::RecordHeader &header, const SiteInfo &site, std::span<const uint8_t> record,
+              std::vector<double> &values) {
+    values.clear();
+    protocol::XorStreamPrefix prefix{};
+    if (record.size() < arguments_offset(site)) {
+      return false;
+    }
+    std::memcpy(&prefix, record.data() + sizeof(protocol::RecordHeader), sizeof(prefix));
+
+    auto &site_streams = streams[static_cast<uint64_t>(header.thread_id) << 32 | header.site_id];
+    if (site_streams.size() <= prefix.stream) {
+      site_streams.resize(prefix.stream + 1);
+    }
+    auto &stream = site_streams[prefix.stream];
+    if (prefix.sequence == 0) {
+      stream = Stream{.next_sequence = 0, .decoders = std::vector<compression::XorFloatDecoder>(
+              static_cast<size_t>(std::ranges::count(site.xor_coded, true)))};
+    } else if (prefix.sequence != stream.next_sequence or stream.decoders.empty()) {
+      // Values of this record depend on a record that is missing
+      stream.decoders.clear();
+      return false;
+    }
+
+    // Bit stream follows all the other arguments
+    const uint8_t *cursor = record.data() + arguments_offset(site);
+    const uint8_t *end = record.data() + record.size();
+    size_t user_argument{0};
+    for (size_t argument = 0; argument < site.argument_types.size(); ++argument) {
+      const auto length = stored_argument_length(site, argument, cursor, static_cast<size_t>(end - cursor), user_argument);
+      if (not length) {
+        stream.decoders.clear();
+        return false;
+      }
+      cursor += *length;
+    }
+    const std::span<const uint8_t> bits{cursor, end};
+    compression::BitReader reader{bits};
+    for (auto &decoder: stream.decoders) {
+      values.push_back(decoder.decode(reader));
+    }
+    if (reader.bits_read() > bits.size() * 8) {
+      stream.decoders.clear();
+      return false;
+    }
+    stream.next_sequence = static_cast<uint16_t>(prefix.sequence + 1);
+    return true;
+  }
+
+  // Has to be called when definition of a site changes
+  void forget_site(const uint32_t site_id) {
+    std::erase_if(streams, [site_id](const auto &entry) { return static_cast<uint32_t>(entry.first) == site_id; });
+  }
+
+private:
+  struct Stream {
+    uint16_t next_sequence{0};
+    // Empty when values of the stream are not known
+    std::vector<compression::XorFloatDecoder> decoders{};
+  };
+
+  // Streams of a thread and site, by ring (see protocol::XorStreamPrefix)
+  std::unordered_map<uint64_t, std::vector<Stream>> streams{};
+};
+
+// Parse time given either as nanoseconds since epoch or as UTC "YYYY-MM-DD[T ]HH:MM:SS[.fraction]"
+inline std::optional<uint64_t> parse_timestamp(const std::string &text) {
+  if (not text.empty() and std::ranges::all_of(text, [](const char character) { return character >= '0' and character <= '9'; })) {
+    return std::stoull(text);
+  }
+  std::tm time{};
+  char separator{};
+  int consumed{0};
+  if (std::sscanf(text.c_str(), "%4d-%2d-%2d%c%2d:%2d:%2d%n", &time.tm_year, &time.tm_mon, &time.tm_mday, &separator,
+                  &time.tm_hour, &time.tm_min, &time.tm_sec, &consumed) != 7 or (separator != 'T' and separator != ' ')) {
+    return std::nullopt;
+  }
+  time.tm_year -= 1900;
+  time.tm_mon -= 1;
+  uint64_t nanoseconds{0};
+  if (consumed < static_cast<int>(text.size()) and text[static_cast<size_t>(consumed)] == '.') {
+    uint64_t scale = 100'000'000;
+    for (size_t position = static_cast<size_t>(consumed) + 1; position < text.size() and scale > 0; ++position, scale /= 10) {
+      nanoseconds += static_cast<uint64_t>(text[position] - '0') * scale;
+    }
+  }
+  return static_cast<uint64_t>(timegm(&time)) * 1'000'000'000 + nanoseconds;
+}
+
+// Binary log opened for reading. Records are read with pread(), so only requested byte ranges are touched
+class LogFile {
+public:
+  explicit LogFile(const std::string &path) : path(path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    protocol::FileHeader header{};
+    if (::pread(fd, &header, sizeof(header), 0) != sizeof(header) or header.magic != protocol::file_magic or
+        header.version != protocol::protocol_version) {
+      ::close(fd);
+      throw std::runtime_error(path + " is not a log4tiny binary log");
+    }
+  }
+
+  LogFile(const LogFile &) = delete;
+
+  LogFile &operator=(const LogFile &) = delete;
+
+  ~LogFile() {
+    ::close(fd);
+  }
+
+  uint64_t size() const {
+    struct stat status{};
+    fstat(fd, &status);
+    return static_cast<uint64_t>(status.st_size);
+  }
+
+  // Load sidecar index if it exists and is valid
+  std::optional<ChunkIndex> load_index() const {
+    const int index_fd = ::open(index_path(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (index_fd < 0) {
+      return std::nullopt;
+    }
+    struct stat status{};
+    fstat(index_fd, &status);
+    std::vector<uint8_t> content(static_cast<size_t>(status.st_size));
+    const auto length = ::pread(index_fd, content.data(), content.size(), 0);
+    ::close(index_fd);
+    protocol::FileHeader header{};
+    if (length < static_cast<ssize_t>(sizeof(header))) {
+      return std::nullopt;
+    }
+    std::memcpy(&header, content.data(), sizeof(header));
+    if (header.magic != protocol::file_magic) {
+      return std::nullopt;
+    }
+    content.resize(static_cast<size_t>(length));
+    content.erase(content.begin(), content.begin() + sizeof(header));
+    return ChunkIndex{complete_records(std::move(content))};
+  }
+
+  // Call function for every complete record within [begin, end) byte range. Range has to start at record boundary
+  void read_records(uint64_t begin, const uint64_t end, const std::function<void(std::span<const uint8_t>)> &function) const {
+    constexpr size_t block_size = 4U << 20;
+    std::vector<uint8_t> buffer{};
+    size_t pending{0};
+    while (begin < end) {
+      const auto block = static_cast<size_t>(std::min<uint64_t>(block_size, end - begin));
+      buffer.resize(pending + block);
+      const auto length = ::pread(fd, buffer.data() + pending, block, static_cast<off_t>(begin));
+      if (length <= 0) {
+        break;
+      }
+      begin += static_cast<uint64_t>(length);
+      const size_t available = pending + static_cast<size_t>(length);
+      const size_t complete = complete_length({buffer.data(), available});
+      protocol::for_each_record({buffer.data(), complete}, function);
+      std::memmove(buffer.data(), buffer.data() + complete, available - complete);
+      pending = available - complete;
+    }
+  }
+
+private:
+  // Length of the prefix holding only complete records
+  static size_t complete_length(std::span<const uint8_t> records) {
+    size_t length{0};
+    while (records.size() - length >= sizeof(uint32_t)) {
+      uint32_t record_length;
+      std::memcpy(&record_length, records.data() + length, sizeof(record_length));
+      if (record_length == 0 or record_length > records.size() - length) {
+        break;
+      }
+      length += record_length;
+    }
+    return length;
+  }
+
+  static std::vector<uint8_t> complete_records(std::vector<uint8_t> records) {
+    records.resize(complete_length(records));
+    return records;
+  }
+
+  std::string path;
+  int fd;
+};
+
+}
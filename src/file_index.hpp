@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <protocol.hpp>
+
+namespace log4tiny {
+
+// Sparse index of a binary log, stored in a sidecar file (see index_path()) so that it can be appended while the log is
+// being written. Sidecar is a record stream starting with protocol::FileHeader and holding:
+// - chunk index records (protocol::ChunkIndexEntry) - one for every chunk (batch) written to the log,
+// - site records - copy of every site definition that appeared in the log, placed before the first chunk using it.
+// Thanks to site records, the decoder can jump straight into the middle of the log and still render records whose
+// site definitions were written in skipped chunks.
+
+inline std::string index_path(const std::string &log_path) {
+  return log_path + ".idx";
+}
+
+// Collects information about records of the chunk being built and produces sidecar records for it
+class ChunkIndexBuilder {
+public:
+  void add(std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (header.kind == protocol::RecordKind::log) {
+      min_timestamp = std::min(min_timestamp, header.timestamp);
+      max_timestamp = std::max(max_timestamp, header.timestamp);
+    } else if (header.kind == protocol::RecordKind::site) {
+      // Every producer thread repeats site definitions - only definitions that changed are stored again
+      const auto definition = record.subspan(sizeof(header));
+      auto &known_definition = known_sites[header.site_id];
+      if (not std::ranges::equal(known_definition, definition)) {
+        known_definition.assign(definition.begin(), definition.end());
+        pending.insert(pending.end(), record.begin(), record.end());
+      }
+    }
+  }
+
+  // Return sidecar records describing chunk that has been written at given offset and start a new chunk
+  std::span<const uint8_t> finish_chunk(const uint64_t offset, const uint64_t length) {
+    const protocol::RecordHeader header{.length = sizeof(protocol::RecordHeader) + sizeof(protocol::ChunkIndexEntry),
+            .kind = protocol::RecordKind::chunk_index, .reserved = 0, .site_id = 0, .thread_id = 0, .timestamp = 0};
+    const protocol::ChunkIndexEntry entry{.offset = offset, .length = length, .min_timestamp = min_timestamp,
+            .max_timestamp = max_timestamp};
+    const auto *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+    const auto *entry_bytes = reinterpret_cast<const uint8_t *>(&entry);
+    pending.insert(pending.end(), header_bytes, header_bytes + sizeof(header));
+    pending.insert(pending.end(), entry_bytes, entry_bytes + sizeof(entry));
+
+    output.swap(pending);
+    pending.clear();
+    min_timestamp = std::numeric_limits<uint64_t>::max();
+    max_timestamp = 0;
+    return output;
+  }
+
+private:
+  uint64_t min_timestamp{std::numeric_limits<uint64_t>::max()};
+  uint64_t max_timestamp{0};
+  std::unordered_map<uint32_t, std::vector<uint8_t>> known_sites{};
+  std::vector<uint8_t> pending{};
+  std::vector<uint8_t> output{};
+};
+
+struct IndexedChunk {
+  protocol::ChunkIndexEntry entry;
+  size_t sidecar_offset; // Offset of the chunk index record within sidecar records
+};
+
+// In-memory view of the sidecar used by decoder
+class ChunkIndex {
+public:
+  explicit ChunkIndex(std::vector<uint8_t> sidecar_records) : records(std::move(sidecar_records)) {
+    size_t offset{0};
+    protocol::for_each_record(records, [&](std::span<const uint8_t> record) {
+      protocol::RecordHeader header{};
+      std::memcpy(&header, record.data(), sizeof(header));
+      if (header.kind == protocol::RecordKind::chunk_index and record.size() >= sizeof(header) + sizeof(protocol::ChunkIndexEntry)) {
+        protocol::ChunkIndexEntry entry{};
+        std::memcpy(&entry, record.data() + sizeof(header), sizeof(entry));
+        chunks.push_back(IndexedChunk{.entry = entry, .sidecar_offset = offset});
+      }
+      offset += record.size();
+    });
+
+    // Records of different threads are not sorted by time, so chunks are searched with running maximum of their
+    // latest timestamps and running minimum (from the end) of their earliest timestamps - both are monotonic
+    running_max.resize(chunks.size());
+    running_min.resize(chunks.size());
+    uint64_t max_timestamp{0};
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+      max_timestamp = std::max(max_timestamp, chunks[chunk].entry.max_timestamp);
+      running_max[chunk] = max_timestamp;
+    }
+    uint64_t min_timestamp{std::numeric_limits<uint64_t>::max()};
+    for (size_t chunk = chunks.size(); chunk > 0; --chunk) {
+      min_timestamp = std::min(min_timestamp, chunks[chunk - 1].entry.min_timestamp);
+      running_min[chunk - 1] = min_timestamp;
+    }
+  }
+
+  // Return range [first, last) of chunks that may contain records with timestamps in [from, to]
+  std::pair<size_t, size_t> find_chunks(const uint64_t from, const uint64_t to) const {
+    const auto first = std::ranges::lower_bound(running_max, from) - running_max.begin();
+    const auto last = std::ranges::upper_bound(running_min, to) - running_min.begin();
+    return {static_cast<size_t>(first), static_cast<size_t>(std::max(first, last))};
+  }
+
+  const std::vector<IndexedChunk> &get_chunks() const {
+    return chunks;
+  }
+
+  std::span<const uint8_t> get_records() const {
+    return records;
+  }
+
+  // End of the last indexed chunk - anything past it has been written after the index was last updated
+  uint64_t indexed_end() const {
+    return chunks.empty() ? 0 : chunks.back().entry.offset + chunks.back().entry.length;
+  }
+
+private:
+  std::vector<uint8_t> records;
+  std::vector<IndexedChunk> chunks{};
+  std::vector<uint64_t> running_max{};
+  std::vector<uint64_t> running_min{};
+};
+
+}
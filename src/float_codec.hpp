@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+namespace log4tiny::compression {
+
+// Bit-granular writer over caller provided storage. Bits are written MSB first so that encoded stream can be read back
+// in the same order by BitReader. Bits are gathered in a 64-bit word, which is stored (big-endian) once full, so every
+// write is a couple of shifts. Remaining bits are stored by flush(), which has to be called before the storage is read.
+// Storage has to be large enough for written data (see XorFloatEncoder::max_encoded_bytes)
+class BitWriter {
+public:
+  constexpr explicit BitWriter(std::span<uint8_t> storage) : storage(storage) {}
+
+  // Write low bit_count bits of value, bit_count up to 64
+  constexpr void write(uint64_t value, const unsigned bit_count) {
+    if (bit_count == 0) {
+      return;
+    }
+    value &= bit_count == 64 ? ~uint64_t{0} : (uint64_t{1} << bit_count) - 1;
+    const unsigned free_bits = 64 - pending_bits;
+    if (bit_count < free_bits) {
+      pending |= value << (free_bits - bit_count);
+      pending_bits += bit_count;
+      return;
+    }
+    // Word is full - bits that do not fit start the next one
+    const unsigned rest = bit_count - free_bits;
+    pending |= value >> rest;
+    store(pending, 8);
+    pending = rest == 0 ? 0 : value << (64 - rest);
+    pending_bits = rest;
+  }
+
+  // Store bits of the word that is not full yet, padded with zero bits to a whole byte
+  constexpr void flush() {
+    store(pending, (pending_bits + 7) / 8);
+    stored_bytes -= (pending_bits + 7) / 8;
+  }
+
+  constexpr size_t bits_written() const {
+    return stored_bytes * 8 + pending_bits;
+  }
+
+  constexpr size_t bytes_written() const {
+    return (bits_written() + 7) / 8;
+  }
+
+private:
+  constexpr void store(const uint64_t word, const size_t byte_count) {
+    for (size_t byte = 0; byte < byte_count; ++byte) {
+      storage[stored_bytes + byte] = static_cast<uint8_t>(word >> (56 - 8 * byte));
+    }
+    stored_bytes += byte_count;
+  }
+
+  std::span<uint8_t> storage;
+  size_t stored_bytes{0};
+  uint64_t pending{0};
+  unsigned pending_bits{0};
+};
+
+// Reader of bits written by BitWriter. Every read takes the 64-bit (big-endian) window starting at the byte holding the
+// next bit. Bits past the end of the storage read as zero
+class BitReader {
+public:
+  constexpr explicit BitReader(std::span<const uint8_t> storage) : storage(storage) {}
+
+  // Read bit_count bits, bit_count up to 64
+  constexpr uint64_t read(const unsigned bit_count) {
+    if (bit_count == 0) {
+      return 0;
+    }
+    const size_t byte = position / 8;
+    const unsigned shift = position % 8;
+    uint64_t window = load(byte) << shift;
+    if (shift + bit_count > 64) {
+      // Up to 7 bits come from the ninth byte
+      window |= static_cast<uint64_t>(byte_at(byte + 8)) >> (8 - shift);
+    }
+    position += bit_count;
+    return window >> (64 - bit_count);
+  }
+
+  constexpr size_t bits_read() const {
+    return position;
+  }
+
+private:
+  constexpr uint8_t byte_at(const size_t index) const {
+    return index < storage.size() ? storage[index] : 0;
+  }
+
+  constexpr uint64_t load(const size_t byte) const {
+    uint64_t word{0};
+    if (byte + 8 <= storage.size()) {
+      for (size_t index = 0; index < 8; ++index) {
+        word = word << 8 | storage[byte + index];
+      }
+      return word;
+    }
+    for (size_t index = 0; index < 8; ++index) {
+      word = word << 8 | byte_at(byte + index);
+    }
+    return word;
+  }
+
+  std::span<const uint8_t> storage;
+  size_t position{0};
+};
+
+// Gorilla-style XOR compression of floating point values (Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory
+// Time Series Database"). Each value is XORed with the previous one from the same stream (i.e. the same call site
+// column) and only the meaningful bits of the residual are stored:
+// '0'                                        - value is identical to the previous one
+// '10' + meaningful bits                     - residual fits in the previous leading/trailing zero window
+// '11' + 5 bits leading + 6 bits length + bits - new window is stored before meaningful bits
+// First value of a stream is stored as raw 64 bits.
+// Encoder and decoder hold the same state, so both sides have to process values of one stream in the same order.
+struct XorFloatState {
+  uint64_t previous_bits{0};
+  unsigned previous_leading{0};
+  unsigned previous_trailing{0};
+  bool has_previous{false};
+};
+
+class XorFloatEncoder {
+public:
+  // '11' + leading + length + 64 meaningful bits, rounded up to whole bytes
+  static constexpr size_t max_encoded_bytes = (2 + 5 + 6 + 64 + 7) / 8;
+
+  constexpr void encode(const double value, BitWriter &writer) {
+    const auto bits = std::bit_cast<uint64_t>(value);
+    if (not state.has_previous) {
+      writer.write(bits, 64);
+      state = XorFloatState{.previous_bits = bits, .previous_leading = 64, .previous_trailing = 0, .has_previous = true};
+      return;
+    }
+
+    const uint64_t residual = bits ^ state.previous_bits;
+    state.previous_bits = bits;
+    if (residual == 0) {
+      writer.write(0b0, 1);
+      return;
+    }
+
+    // Leading zero count has to fit in 5 bits
+    const auto leading = std::min(static_cast<unsigned>(std::countl_zero(residual)), 31U);
+    const auto trailing = static_cast<unsigned>(std::countr_zero(residual));
+    if (leading >= state.previous_leading and trailing >= state.previous_trailing) {
+      const unsigned meaningful = 64 - state.previous_leading - state.previous_trailing;
+      writer.write(0b10, 2);
+      writer.write(residual >> state.previous_trailing, meaningful);
+      return;
+    }
+
+    const unsigned meaningful = 64 - leading - trailing;
+    writer.write(0b11, 2);
+    writer.write(leading, 5);
+    // Length of 64 does not fit in 6 bits and is stored as 0 (length of 0 is impossible for non-zero residual)
+    writer.write(meaningful & 0x3FU, 6);
+    writer.write(residual >> trailing, meaningful);
+    state.previous_leading = leading;
+    state.previous_trailing = trailing;
+  }
+
+  constexpr void reset() {
+    state = XorFloatState{};
+  }
+
+private:
+  XorFloatState state{};
+};
+
+class XorFloatDecoder {
+public:
+  constexpr double decode(BitReader &reader) {
+    if (not state.has_previous) {
+      const uint64_t bits = reader.read(64);
+      state = XorFloatState{.previous_bits = bits, .previous_leading = 64, .previous_trailing = 0, .has_previous = true};
+      return std::bit_cast<double>(bits);
+    }
+
+    if (reader.read(1) == 0b0) {
+      return std::bit_cast<double>(state.previous_bits);
+    }
+
+    if (reader.read(1) == 0b1) {
+      state.previous_leading = static_cast<unsigned>(reader.read(5));
+      const auto length = static_cast<unsigned>(reader.read(6));
+      const unsigned meaningful = length == 0 ? 64 : length;
+      state.previous_trailing = 64 - state.previous_leading - meaningful;
+    }
+
+    const unsigned meaningful = 64 - state.previous_leading - state.previous_trailing;
+    state.previous_bits ^= reader.read(meaningful) << state.previous_trailing;
+    return std::bit_cast<double>(state.previous_bits);
+  }
+
+  constexpr void reset() {
+    state = XorFloatState{};
+  }
+
+private:
+  XorFloatState state{};
+};
+
+}
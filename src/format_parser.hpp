@@ -2,6 +2,8 @@
 
 #include <string_view>
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <optional>
 #include <ranges>
 #include <type_matcher.hpp>
@@ -88,6 +90,40 @@ constexpr std::optional<std::string_view> consume_start_character(const std::str
   return consume_character(format, '%');
 }
 
+constexpr std::optional<std::string_view> consume_name_character(const std::string_view &format) {
+  if (not format.empty() and ((format.front() >= 'a' and format.front() <= 'z') or
+                              (format.front() >= 'A' and format.front() <= 'Z') or
+                              (format.front() >= '0' and format.front() <= '9') or format.front() == '_')) {
+    return format.substr(1);
+  }
+  return std::nullopt;
+}
+
+// Consume name of a named placeholder (e.g. "%{order_id}u") and return its length, zero for unnamed placeholder. Name
+// is an identifier, so that it can serve as a key of structured output as is. Malformed name makes the placeholder
+// invalid (std::nullopt)
+constexpr auto consume_name_if_any(const std::string_view &format) {
+  struct ReturnValue {
+    std::optional<std::string_view> substring;
+    size_t name_length;
+  };
+
+  const auto post_brace_substring = consume_character(format, '{');
+  if (not post_brace_substring) {
+    return ReturnValue{.substring = format, .name_length = 0};
+  }
+  const auto post_name_substring = consume_repeatedly(consume_name_character, post_brace_substring.value());
+  const size_t name_length = post_brace_substring->size() - post_name_substring->size();
+  if (name_length == 0 or (post_brace_substring->front() >= '0' and post_brace_substring->front() <= '9') or
+      post_name_substring->empty()) {
+    return ReturnValue{.substring = std::nullopt, .name_length = 0};
+  }
+  if (const auto substring = consume_character(post_name_substring.value(), '}')) {
+    return ReturnValue{.substring = substring, .name_length = name_length};
+  }
+  return ReturnValue{.substring = std::nullopt, .name_length = 0};
+}
+
 constexpr std::string_view consume_flags_if_any(const std::string_view &format) {
   const auto substring = consume_character_from_set(format, '+', '-', ' ', '#', '0');
   return substring.value_or(format);
@@ -235,8 +271,8 @@ constexpr auto consume_specifier(const std::string_view &format, const std::vect
   return Result{.substring = std::nullopt, .placeholder_type_matcher = matcher::PlaceholderType{}};
 }
 
-// Try to match %[flags][width][.precision][length]specifier prototype and return information about additional arguments
-// required (if needed) as well as length of parsed placeholder
+// Try to match %[{name}][flags][width][.precision][length]specifier prototype and return information about additional
+// arguments required (if needed) as well as length of parsed placeholder
 constexpr auto parse_first_placeholder(const std::string_view &format) {
   struct ReturnValue {
     bool is_valid;
@@ -246,8 +282,12 @@ constexpr auto parse_first_placeholder(const std::string_view &format) {
 
   try {
     if (const auto post_start_substring = consume_start_character(format)) {
+      const auto [post_name_substring, name_length] = consume_name_if_any(post_start_substring.value());
+      if (not post_name_substring) {
+        return ReturnValue{.is_valid = false, .type_matchers = {}, .placeholder_length = 0};
+      }
       std::vector<matcher::PlaceholderType> placeholder_type_matchers{};
-      const auto post_flags_substring = consume_flags_if_any(post_start_substring.value());
+      const auto post_flags_substring = consume_flags_if_any(post_name_substring.value());
       const auto [post_width_substring, width_type_matcher] = consume_width_if_any(post_flags_substring);
       if (width_type_matcher) {
         placeholder_type_matchers.emplace_back(width_type_matcher.value());
@@ -298,6 +338,183 @@ constexpr std::vector<matcher::PlaceholderType> parse_format_to_placeholder_matc
   return result;
 }
 
+// printf length modifier of a placeholder - decides the width integers are truncated to when rendered
+enum class LengthModifier : uint8_t {
+  none,
+  hh,
+  h,
+  l,
+  ll,
+  j,
+  z,
+  t,
+  L
+};
+
+constexpr LengthModifier parse_length_modifier(const std::string_view &modifier) {
+  if (modifier == "hh") {
+    return LengthModifier::hh;
+  }
+  if (modifier == "ll") {
+    return LengthModifier::ll;
+  }
+  if (modifier.size() != 1) {
+    return LengthModifier::none;
+  }
+  switch (modifier.front()) {
+    case 'h':
+      return LengthModifier::h;
+    case 'l':
+      return LengthModifier::l;
+    case 'j':
+      return LengthModifier::j;
+    case 'z':
+      return LengthModifier::z;
+    case 't':
+      return LengthModifier::t;
+    case 'L':
+      return LengthModifier::L;
+    default:
+      return LengthModifier::none;
+  }
+}
+
+// Full description of a single placeholder, as needed to render it at runtime. Only one flag is recognized, the same as
+// in consume_flags_if_any()
+struct PlaceholderSpecification {
+  char flag{'\0'};
+  // Zero padding is requested either by '0' flag or by width starting with '0' following other flag (e.g. "%+05d")
+  bool zero_padding{false};
+  std::optional<unsigned> width{};
+  bool width_from_argument{false};
+  std::optional<unsigned> precision{};
+  bool precision_from_argument{false};
+  LengthModifier length_modifier{LengthModifier::none};
+  char specifier{'\0'};
+  size_t length{0};
+  // Name of named placeholder starts right after "%{" - see FormatFragment::get_name()
+  size_t name_length{0};
+
+  // Number of arguments consumed by the placeholder, including '*' width and precision
+  constexpr size_t argument_count() const {
+    return 1 + (width_from_argument ? 1 : 0) + (precision_from_argument ? 1 : 0);
+  }
+};
+
+constexpr unsigned parse_unsigned(const std::string_view &digits) {
+  unsigned value{0};
+  for (const char digit: digits) {
+    value = value * 10 + static_cast<unsigned>(digit - '0');
+  }
+  return value;
+}
+
+// Parse placeholder at the beginning of format with the same consumers that are used by parse_first_placeholder()
+constexpr std::optional<PlaceholderSpecification> parse_placeholder_specification(const std::string_view &format) {
+  try {
+    const auto post_start_substring = consume_start_character(format);
+    if (not post_start_substring) {
+      return std::nullopt;
+    }
+    const auto [post_name_substring, name_length] = consume_name_if_any(post_start_substring.value());
+    if (not post_name_substring) {
+      return std::nullopt;
+    }
+    PlaceholderSpecification specification{.name_length = name_length};
+    const auto post_flags_substring = consume_flags_if_any(post_name_substring.value());
+    if (post_flags_substring.size() != post_name_substring->size()) {
+      specification.flag = post_name_substring->front();
+    }
+
+    const auto [post_width_substring, width_type_matcher] = consume_width_if_any(post_flags_substring);
+    specification.width_from_argument = width_type_matcher.has_value();
+    if (not width_type_matcher and post_width_substring.size() != post_flags_substring.size()) {
+      specification.width = parse_unsigned(post_flags_substring.substr(0, post_flags_substring.size() - post_width_substring.size()));
+      specification.zero_padding = post_flags_substring.front() == '0';
+    }
+    specification.zero_padding = specification.zero_padding or specification.flag == '0';
+
+    const auto [post_precision_substring, precision_type_matcher] = consume_precision_if_any(post_width_substring);
+    specification.precision_from_argument = precision_type_matcher.has_value();
+    if (not precision_type_matcher and post_precision_substring.size() != post_width_substring.size()) {
+      // Skip '.' - precision without digits means 0
+      specification.precision = parse_unsigned(post_width_substring.substr(1, post_width_substring.size() - post_precision_substring.size() - 1));
+    }
+
+    const auto [post_length_substring, allowed_specifiers] = consume_length_if_any(post_precision_substring);
+    specification.length_modifier = parse_length_modifier(
+            post_precision_substring.substr(0, post_precision_substring.size() - post_length_substring.size()));
+    if (const auto [post_specifier_substring, specifier_type_matcher] = consume_specifier(post_length_substring,
+                                                                                          allowed_specifiers); post_specifier_substring) {
+      specification.specifier = post_length_substring.front();
+      specification.length = static_cast<size_t>(std::distance(format.cbegin(), post_specifier_substring->cbegin()));
+      return specification;
+    }
+  }
+  catch (const std::exception &exception) {
+  }
+  return std::nullopt;
+}
+
+// Piece of a format - literal text (given as a range of the format) followed by a placeholder, if any. "%%" ends the
+// literal with a single '%' and the next fragment starts after it
+struct FormatFragment {
+  size_t literal_offset{0};
+  size_t literal_length{0};
+  size_t first_argument{0};
+  std::optional<PlaceholderSpecification> placeholder{};
+
+  // Name of the placeholder within given format, empty when the placeholder is not named
+  constexpr std::string_view get_name(const std::string_view &format) const {
+    if (not placeholder or placeholder->name_length == 0) {
+      return {};
+    }
+    return format.substr(literal_offset + literal_length + 2, placeholder->name_length);
+  }
+};
+
+// Split format into fragments, with placeholders recognized the same way as by parse_format_to_placeholder_matchers()
+constexpr std::vector<FormatFragment> split_format(const std::string_view &format) {
+  std::vector<FormatFragment> fragments{};
+  size_t literal_offset{0};
+  size_t next_argument{0};
+  size_t position{0};
+  while (position < format.size()) {
+    if (format[position] != '%') {
+      ++position;
+      continue;
+    }
+    if (format.substr(position).starts_with("%%")) {
+      fragments.push_back(FormatFragment{.literal_offset = literal_offset, .literal_length = position + 1 - literal_offset,
+              .first_argument = next_argument, .placeholder = std::nullopt});
+      position += 2;
+      literal_offset = position;
+    } else if (const auto placeholder = parse_placeholder_specification(format.substr(position))) {
+      fragments.push_back(FormatFragment{.literal_offset = literal_offset, .literal_length = position - literal_offset,
+              .first_argument = next_argument, .placeholder = placeholder});
+      next_argument += placeholder->argument_count();
+      position += placeholder->length;
+      literal_offset = position;
+    } else {
+      ++position;
+    }
+  }
+  if (literal_offset < format.size()) {
+    fragments.push_back(FormatFragment{.literal_offset = literal_offset, .literal_length = format.size() - literal_offset,
+            .first_argument = next_argument, .placeholder = std::nullopt});
+  }
+  return fragments;
+}
+
+// Fragments of a format computed at compile time. Every tinylog call site has its own format_view, so this is a constant
+// array per call site, available to in-process sinks that render text without interpreting the format at runtime
+template<const std::string_view &format>
+inline constexpr auto format_fragments = [] {
+  std::array<FormatFragment, split_format(format).size()> fragments{};
+  std::ranges::copy(split_format(format), fragments.begin());
+  return fragments;
+}();
+
 template<const std::string_view &format, typename... T>
 constexpr void verify_format_with_arguments(const T &... args) {
   static_assert(sizeof...(T) == parse_format_to_placeholder_matchers(format).size(),
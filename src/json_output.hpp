@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <decoder.hpp>
+
+namespace log4tiny::json {
+
+// JSON Lines rendering of decoded records, written straight into the output line without building any document.
+// Strings are escaped a word (8 bytes) at a time: runs of bytes that need no escaping - nearly all of a log - are
+// found with a few arithmetic operations per word and appended at once. Integers share the two-digit table of text
+// rendering, floating point values are written with std::to_chars in the shortest form that reads back exactly.
+
+inline constexpr uint64_t byte_ones = 0x0101010101010101ULL;
+inline constexpr uint64_t byte_high_bits = 0x8080808080808080ULL;
+
+// High bit set in bytes of word that need escaping: '"', '\\' and control characters. Bytes above the lowest flagged
+// one may be flagged falsely (borrows propagate upwards), the lowest one is always exact. Bytes of UTF-8 sequences are
+// never flagged
+inline uint64_t escape_mask(const uint64_t word) {
+  const auto zero_bytes = [](const uint64_t value) {
+    return (value - byte_ones) & ~value & byte_high_bits;
+  };
+  const uint64_t quotes = zero_bytes(word ^ (byte_ones * '"'));
+  const uint64_t backslashes = zero_bytes(word ^ (byte_ones * '\\'));
+  const uint64_t controls = (word - byte_ones * 0x20) & ~word & byte_high_bits;
+  return quotes | backslashes | controls;
+}
+
+inline bool needs_escape(const char character) {
+  return character == '"' or character == '\\' or static_cast<unsigned char>(character) < 0x20;
+}
+
+inline void append_escaped_character(std::string &output, const char character) {
+  switch (character) {
+    case '"':
+      output += "\\\"";
+      break;
+    case '\\':
+      output += "\\\\";
+      break;
+    case '\n':
+      output += "\\n";
+      break;
+    case '\r':
+      output += "\\r";
+      break;
+    case '\t':
+      output += "\\t";
+      break;
+    case '\b':
+      output += "\\b";
+      break;
+    case '\f':
+      output += "\\f";
+      break;
+    default: {
+      const char escape[] = {'\\', 'u', '0', '0', "0123456789abcdef"[character >> 4], "0123456789abcdef"[character & 0xF]};
+      output.append(escape, sizeof(escape));
+    }
+  }
+}
+
+// Append string in double quotes. Bytes are passed through as they are, so valid UTF-8 stays valid
+inline void append_string(std::string &output, const std::string_view string) {
+  output.push_back('"');
+  const char *run = string.data();
+  const char *cursor = string.data();
+  const char *const end = string.data() + string.size();
+  while (cursor != end) {
+    if constexpr (std::endian::native == std::endian::little) {
+      if (end - cursor >= static_cast<ptrdiff_t>(sizeof(uint64_t))) {
+        uint64_t word;
+        std::memcpy(&word, cursor, sizeof(word));
+        const uint64_t mask = escape_mask(word);
+        if (mask == 0) {
+          cursor += sizeof(word);
+          continue;
+        }
+        cursor += std::countr_zero(mask) / 8;
+      } else if (not needs_escape(*cursor)) {
+        ++cursor;
+        continue;
+      }
+    } else if (not needs_escape(*cursor)) {
+      ++cursor;
+      continue;
+    }
+    output.append(run, static_cast<size_t>(cursor - run));
+    append_escaped_character(output, *cursor);
+    run = ++cursor;
+  }
+  output.append(run, static_cast<size_t>(end - run));
+  output.push_back('"');
+}
+
+inline void append_unsigned(std::string &output, const uint64_t value) {
+  std::array<char, 20> buffer;
+  char *const end = buffer.data() + buffer.size();
+  const char *begin = text::write_decimal_backwards(end, value);
+  output.append(begin, static_cast<size_t>(end - begin));
+}
+
+inline void append_signed(std::string &output, const int64_t value) {
+  if (value < 0) {
+    output.push_back('-');
+  }
+  append_unsigned(output, value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+}
+
+// JSON has no representation of infinities and NaN, they are written as null
+inline void append_double(std::string &output, const double value) {
+  if (not std::isfinite(value)) {
+    output += "null";
+    return;
+  }
+  std::array<char, 32> buffer;
+  const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+  output.append(buffer.data(), result.ptr);
+}
+
+// Typed value of an argument: numbers for integers and floating point values, strings for characters, strings and
+// pointers (as "0x..." - 64-bit addresses do not survive parsers reading numbers as doubles). Values of user types are
+// strings with their rendered text (see codec)
+inline void append_argument(std::string &output, const protocol::ArgumentValue &value) {
+  switch (value.type) {
+    case protocol::ArgumentType::signed_int:
+      append_signed(output, value.signed_int);
+      break;
+    case protocol::ArgumentType::unsigned_int:
+      append_unsigned(output, value.unsigned_int);
+      break;
+    // Decoded XOR coded values are floating (see decoder::parse_site_record()), listed for completeness
+    case protocol::ArgumentType::xor_floating:
+    case protocol::ArgumentType::floating:
+      append_double(output, value.floating);
+      break;
+    case protocol::ArgumentType::character:
+      append_string(output, {&value.character, 1});
+      break;
+    case protocol::ArgumentType::string:
+      append_string(output, value.string);
+      break;
+    case protocol::ArgumentType::pointer: {
+      std::array<char, 18> buffer;
+      char *const end = buffer.data() + buffer.size();
+      char *begin = text::write_hexadecimal_backwards(end, value.unsigned_int, false);
+      *--begin = 'x';
+      *--begin = '0';
+      append_string(output, {begin, static_cast<size_t>(end - begin)});
+      break;
+    }
+    case protocol::ArgumentType::user:
+      append_string(output, text::render_user_value(value));
+      break;
+  }
+}
+
+inline std::string_view level_name(const protocol::Level level) {
+  switch (level) {
+    case protocol::Level::debug:
+      return "debug";
+    case protocol::Level::error:
+      return "error";
+    default:
+      return "info";
+  }
+}
+
+// Append record of given site as a single JSON object (without the trailing newline):
+// {"timestamp":<ns>,"thread":<id>,"level":"info","file":"...","line":<n>,"format":"...","message":"...","args":{...}}
+// Arguments are keyed by field names of the site (see RenderProgram::get_field_names()), each with the value of its
+// placeholder. Arguments that the record lacks are null
+inline void append_record(std::string &output, const protocol::RecordHeader &header, const decoder::SiteInfo &site,
+                          std::span<const protocol::ArgumentValue> arguments) {
+  output += "{\"timestamp\":";
+  append_unsigned(output, header.timestamp);
+  output += ",\"thread\":";
+  append_unsigned(output, header.thread_id);
+  output += ",\"level\":\"";
+  output += level_name(site.level);
+  output += "\",\"file\":";
+  append_string(output, site.file);
+  output += ",\"line\":";
+  append_unsigned(output, site.line);
+  output += ",\"format\":";
+  append_string(output, site.format);
+  output += ",\"message\":";
+  // Message is rendered aside, to be escaped word by word as any other string
+  static thread_local std::string message{};
+  message.clear();
+  site.program.render(message, arguments);
+  append_string(output, message);
+  output += ",\"args\":{";
+  size_t field{0};
+  for (const auto &fragment: site.program.get_fragments()) {
+    if (not fragment.placeholder) {
+      continue;
+    }
+    if (field != 0) {
+      output.push_back(',');
+    }
+    append_string(output, site.program.get_field_names()[field++]);
+    output.push_back(':');
+    // Value of the placeholder follows its '*' width and precision
+    const auto argument = fragment.first_argument + fragment.placeholder->argument_count() - 1;
+    if (argument < arguments.size()) {
+      append_argument(output, arguments[argument]);
+    } else {
+      output += "null";
+    }
+  }
+  output += "}}";
+}
+
+}
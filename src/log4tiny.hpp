@@ -1,24 +1,301 @@
 #pragma once
 
-#include <iostream>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <backtrace.hpp>
 #include <crc32.hpp>
+#include <float_codec.hpp>
 #include <format_parser.hpp>
+#include <producer.hpp>
+#include <protocol.hpp>
+#include <rate_limiter.hpp>
+#include <sampling.hpp>
+#include <site_counters.hpp>
+#include <text_output.hpp>
 
 namespace log4tiny {
 
-template<const std::string_view &format, typename... T>
-constexpr void log(const uint32_t file_hash, const size_t line, const T &... args) {
+namespace detail {
+
+// Copy debug records buffered by the thread into given ring, without publishing them. Length of each record is written
+// last by commit, as for any other record
+inline void flush_backtrace(ThreadContext &context, ProducerRing &ring) {
+  context.backtrace.drain(context.epoch, [&](std::span<const uint8_t> record) {
+    auto *destination = ring.reserve(record.size());
+    if (destination == nullptr) {
+      context.counters.count_drop();
+      return;
+    }
+    constexpr auto skipped = offsetof(protocol::RecordHeader, kind);
+    std::memcpy(destination + skipped, record.data() + skipped, record.size() - skipped);
+    ring.commit(destination, record.size(), false);
+    context.counters.count_record(record.size(), ring.get_occupancy());
+  });
+}
+
+template<typename T>
+constexpr bool is_floating_argument() {
+  return protocol::argument_type_of<T>() == protocol::ArgumentType::floating;
+}
+
+// Coder state of floating point arguments of a site, kept by every thread for the stream it writes to (see
+// protocol::XorStreamPrefix)
+template<size_t columns>
+struct XorStreamState {
+  uint64_t epoch{0};
+  const ProducerRing *ring{nullptr};
+  // Sequence number of the next record, the stream starts over when it reaches key interval
+  uint16_t sequence{protocol::xor_key_interval};
+  std::array<compression::XorFloatEncoder, columns> encoders{};
+};
+
+// Bytes of the argument among other arguments of a record with XOR coded floating point arguments
+template<typename T>
+size_t xor_record_encoded_size(const T &argument) {
+  if constexpr (is_floating_argument<T>()) {
+    return 0;
+  } else {
+    return protocol::encoded_size(argument);
+  }
+}
+
+template<typename T>
+uint8_t *encode_xor_record_argument(uint8_t *destination, const T &argument) {
+  if constexpr (is_floating_argument<T>()) {
+    return destination;
+  } else {
+    return protocol::encode_argument(destination, argument);
+  }
+}
+
+template<size_t columns, typename T>
+void encode_xor_floating(const T &argument, std::array<compression::XorFloatEncoder, columns> &encoders,
+                         size_t &column, compression::BitWriter &writer) {
+  if constexpr (is_floating_argument<T>()) {
+    encoders[column++].encode(static_cast<double>(argument), writer);
+  }
+}
+
+}
+
+// Encode record into ring of calling thread. Before the first record of given call site, the thread emits site
+// record describing it, so that stream of every thread can be decoded independently. When text output is set (see
+// set_text_output()), record is rendered and written as text instead. When built with LOG4TINY_SITE_COUNTERS, every
+// call is counted by its site (see site_volumes()). Sampling rate of the site is recorded in its site record, so that
+// decoder can scale volumes of sampled sites back. Debug records go to the backtrace buffer of the thread instead of its
+// ring, error records are preceded by the buffered ones (see Level) - text output writes both right away. With
+// xor_floats, floating point arguments are XOR coded against the previous record of the site written by the thread (see
+// protocol::XorStreamPrefix) - except for debug records, which may be dropped from the backtrace buffer.
+template<const std::string_view &format, const std::string_view &file, uint32_t sampling_rate = 1,
+         Level level = Level::info, bool xor_floats = false, typename... T>
+void log(const uint32_t file_hash, const size_t line, const T &... args) {
   ::log4tiny::verify_format_with_arguments<format>(args...);
+
+  const auto length = protocol::align_record_length(sizeof(protocol::RecordHeader) + (protocol::encoded_size(args) + ... + 0));
+#ifdef LOG4TINY_SITE_COUNTERS
+  static detail::SiteCounter site_counter{file_hash, static_cast<uint32_t>(line), file, format, sampling_rate};
+  site_counter.count(length);
+#endif
+
+  if (const int text_fd = detail::text_output_fd.load(std::memory_order_relaxed); text_fd >= 0) {
+    detail::write_text_line<format, file>(text_fd, line, args...);
+    return;
+  }
+
+  static const uint32_t site_id = detail::next_site_id.fetch_add(1, std::memory_order_relaxed);
+  // With rings shared between threads a single definition serves all threads, otherwise every thread defines the site
+  // in its own ring
+  static std::atomic<uint64_t> shared_site_defined_epoch{0};
+  static thread_local uint64_t site_defined_epoch = 0;
+  constexpr size_t xor_columns = ((detail::is_floating_argument<T>() ? 1 : 0) + ... + 0);
+  constexpr bool xor_coded = xor_floats and level != Level::debug and xor_columns != 0;
+
+  auto &context = detail::thread_context();
+  if (not context.ensure_ring()) {
+    return;
+  }
+
+  const protocol::RecordHeader header{.length = 0, .kind = protocol::RecordKind::log, .reserved = 0,
+          .site_id = site_id, .thread_id = context.thread_id, .timestamp = detail::timestamp_now()};
+
+  const bool shared_definition = producer_mode == ProducerMode::shared_ring or not context.cpu_rings.empty();
+  const uint64_t defined_epoch = shared_definition ? shared_site_defined_epoch.load(std::memory_order_acquire)
+                                                   : site_defined_epoch;
+  if (defined_epoch != context.epoch) {
+    auto site_header = header;
+    site_header.kind = protocol::RecordKind::site;
+    const auto site_length = protocol::site_record_length<T...>(file, format);
+    // Site record has to precede records of the site in every ring they may be written to
+    const auto site_rings = context.cpu_rings.empty() ? std::span<ProducerRing>{context.ring, 1} : context.cpu_rings;
+    for (auto &ring: site_rings) {
+      auto *destination = ring.reserve(site_length);
+      if (destination == nullptr) {
+        context.counters.count_drop();
+        return;
+      }
+      protocol::write_site_record<T...>(destination, site_header, file_hash, static_cast<uint32_t>(line), file, format,
+                                        sampling_rate, level, xor_coded);
+      ring.commit(destination, site_length, context.batch_depth == 0);
+      context.counters.count_record(site_length, ring.get_occupancy());
+    }
+    if (shared_definition) {
+      // Records of other threads that see the new epoch are reserved after the site records
+      shared_site_defined_epoch.store(context.epoch, std::memory_order_release);
+    } else {
+      site_defined_epoch = context.epoch;
+    }
+  }
+
+  if constexpr (level == Level::debug) {
+    if (auto *destination = context.backtrace.reserve(length, context.epoch); destination != nullptr) {
+      protocol::write_record_header(destination, header);
+      auto *cursor = destination + sizeof(header);
+      ((cursor = protocol::encode_argument(cursor, args)), ...);
+      context.backtrace.commit(destination, length);
+    }
+    return;
+  }
+
+  auto *ring = context.current_ring();
+  if constexpr (level == Level::error) {
+    // Published together with the error record
+    detail::flush_backtrace(context, *ring);
+  }
+  if constexpr (xor_coded) {
+    // State is stored only once the record made it into the ring, so that a dropped record does not break the stream
+    static thread_local detail::XorStreamState<xor_columns> xor_state{};
+    auto state = xor_state;
+    if (state.epoch != context.epoch or state.ring != ring or state.sequence == protocol::xor_key_interval) {
+      state = detail::XorStreamState<xor_columns>{.epoch = context.epoch, .ring = ring, .sequence = 0, .encoders = {}};
+    }
+    std::array<uint8_t, xor_columns * compression::XorFloatEncoder::max_encoded_bytes> bits;
+    compression::BitWriter writer{bits};
+    size_t column{0};
+    (detail::encode_xor_floating(args, state.encoders, column, writer), ...);
+    writer.flush();
+
+    const auto xor_length = protocol::align_record_length(sizeof(protocol::RecordHeader) + sizeof(protocol::XorStreamPrefix) +
+                                                          (detail::xor_record_encoded_size(args) + ... + 0) +
+                                                          writer.bytes_written());
+    auto *destination = ring->reserve(xor_length);
+    if (destination == nullptr) {
+      context.counters.count_drop();
+      return;
+    }
+    const protocol::XorStreamPrefix prefix{
+            .stream = static_cast<uint16_t>(context.cpu_rings.empty() ? 0 : ring - context.cpu_rings.data()),
+            .sequence = state.sequence++};
+    protocol::write_record_header(destination, header);
+    auto *cursor = destination + sizeof(header);
+    std::memcpy(cursor, &prefix, sizeof(prefix));
+    cursor += sizeof(prefix);
+    ((cursor = detail::encode_xor_record_argument(cursor, args)), ...);
+    std::memcpy(cursor, bits.data(), writer.bytes_written());
+    ring->commit(destination, xor_length, context.batch_depth == 0);
+    context.counters.count_record(xor_length, ring->get_occupancy());
+    xor_state = state;
+  } else {
+    auto *destination = ring->reserve(length);
+    if (destination == nullptr) {
+      context.counters.count_drop();
+      return;
+    }
+    protocol::write_record_header(destination, header);
+    auto *cursor = destination + sizeof(header);
+    ((cursor = protocol::encode_argument(cursor, args)), ...);
+    ring->commit(destination, length, context.batch_depth == 0);
+    context.counters.count_record(length, ring->get_occupancy());
+  }
+  if (context.batch_depth == 0) {
+    context.wake_consumer();
+  }
 }
 
+// Scope within which tinylog records of the calling thread are committed to its ring but published to the consumer
+// all at once, with a single store of the write index when the outermost scope ends - instead of one per record.
+// Records stay invisible to the consumer until then, so batches should be short (e.g. one iteration of a processing
+// loop). When the ring fills up, pending records are published early. Shared rings publish every record on its own,
+// there the batch has no effect.
+class RecordBatch {
+public:
+  RecordBatch() {
+    ++detail::thread_context().batch_depth;
+  }
+
+  RecordBatch(const RecordBatch &) = delete;
+
+  RecordBatch &operator=(const RecordBatch &) = delete;
+
+  ~RecordBatch() {
+    auto &context = detail::thread_context();
+    if (--context.batch_depth == 0) {
+      context.publish();
+    }
+  }
+};
+
 #define _TINYLOG_CALCULATE_CRC32(file_path) std::integral_constant<uint32_t, compute_crc32(file_path, sizeof(file_path)-1)>::value
 
-#define tinylog(...) _TINYLOG_EXTRACT_FORMAT(__VA_ARGS__)
+#define tinylog(...) _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::info, false, __VA_ARGS__)
+
+// Debug record, kept in the backtrace buffer of the thread until it logs an error record (see Level)
+#define tinylog_debug(...) _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::debug, false, __VA_ARGS__)
+
+// Error record, written after the debug records buffered by the thread
+#define tinylog_error(...) _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::error, false, __VA_ARGS__)
+
+// Variant of tinylog for sites logging slowly changing floating point values (e.g. prices, latencies): each floating
+// point argument is stored as XOR with its previous value from the same thread (see protocol::XorStreamPrefix), which
+// takes a few bits instead of 8 bytes when values repeat or differ in low bits only
+#define tinylog_xor_floats(...) _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::info, true, __VA_ARGS__)
+
+#define _TINYLOG_EXTRACT_FORMAT(sampling_rate, level, xor_floats, format_char_array, ...)                     \
+{                                                                                                             \
+static constexpr std::string_view format_view = format_char_array;                                            \
+static constexpr std::string_view file_view = __FILE__;                                                       \
+::log4tiny::log<format_view, file_view, sampling_rate, level, xor_floats>(_TINYLOG_CALCULATE_CRC32(__FILE__), __LINE__ __VA_OPT__(,) __VA_ARGS__); \
+}
+
+// Variant of tinylog for sites that may fire in storms: at most `burst` records at once and `records_per_second` on
+// average pass (see RateLimiter), the rest is suppressed. When a thread gets a record through again, number of its
+// records suppressed in between is logged just before the record itself, by a summary record. Summary is a call site
+// of its own (same file and line, format "%llu records suppressed by rate limit"), as its format differs.
+#define tinylog_rate_limited(records_per_second, burst, ...)                                                 \
+{                                                                                                             \
+static ::log4tiny::RateLimiter rate_limiter{records_per_second, burst};                                       \
+static thread_local uint64_t suppressed_by_thread = 0;                                                        \
+if (const auto suppressed = rate_limiter.acquire(::log4tiny::detail::timestamp_now(), suppressed_by_thread)) { \
+  if (*suppressed != 0) {                                                                                     \
+    _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::info, false, "%llu records suppressed by rate limit", static_cast<unsigned long long>(*suppressed)) \
+  }                                                                                                           \
+  _TINYLOG_EXTRACT_FORMAT(1, ::log4tiny::Level::info, false, __VA_ARGS__)                                     \
+}                                                                                                             \
+}
+
+// Variant of tinylog logging 1 in `rate` calls of the site made by each thread - the first one and then every rate-th.
+// Rate has to be a constant expression
+#define tinylog_sampled(rate, ...)                                                                            \
+{                                                                                                             \
+static_assert((rate) > 0, "Sampling rate has to be positive");                                                \
+static thread_local uint32_t calls_to_skip = 0;                                                               \
+if (calls_to_skip-- == 0) {                                                                                   \
+  calls_to_skip = (rate) - 1;                                                                                 \
+  _TINYLOG_EXTRACT_FORMAT(rate, ::log4tiny::Level::info, false, __VA_ARGS__)                                  \
+}                                                                                                             \
+}
 
-#define _TINYLOG_EXTRACT_FORMAT(format_char_array, ...)                                  \
-{                                                                                        \
-static constexpr std::string_view format_view = format_char_array;                       \
-::log4tiny::log<format_view>(_TINYLOG_CALCULATE_CRC32(__FILE__), __LINE__, __VA_ARGS__); \
+// Variant of tinylog logging calls whose key (e.g. request id - an integer or a string) falls into the sampled 1 in
+// `rate` of all keys (see sampling_hash()). All records of a key are kept or dropped together, across sites and
+// processes sampling at the same rate. Rate has to be a constant expression
+#define tinylog_sampled_by(rate, key, ...)                                                                    \
+{                                                                                                             \
+static_assert((rate) > 0, "Sampling rate has to be positive");                                                \
+if (::log4tiny::is_sampled(key, rate)) {                                                                      \
+  _TINYLOG_EXTRACT_FORMAT(rate, ::log4tiny::Level::info, false, __VA_ARGS__)                                  \
+}                                                                                                             \
 }
 
 }
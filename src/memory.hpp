@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace log4tiny {
+
+enum class HugePages {
+  none,
+  // Ask kernel to back memory with transparent huge pages (madvise(MADV_HUGEPAGE))
+  transparent,
+  // Allocate from the pool of explicit huge pages (MAP_HUGETLB), falling back to transparent ones when pool is empty.
+  // Memory mapped by its owner (shared memory segment) can only use transparent huge pages
+  explicit_pool
+};
+
+struct MemoryOptions {
+  HugePages huge_pages{HugePages::none};
+  // Touch all pages up front, so that the hot path never takes a page fault
+  bool prefault{false};
+  // Keep pages resident (mlock()). Subject to RLIMIT_MEMLOCK - failure is ignored
+  bool lock{false};
+};
+
+inline constexpr size_t huge_page_size = 2U << 20;
+
+// Allocator of large long-lived buffers - producer rings and staging buffers of sinks. Memory that is not allocated,
+// but mapped by its owner (e.g. shared memory segment of the transport), is passed to prepare() instead - or to
+// advise() first and populate() range by range later, when the owner places parts of the memory (e.g. on NUMA nodes)
+// before they may be touched
+class BufferAllocator {
+public:
+  virtual ~BufferAllocator() = default;
+
+  // Return memory of at least given size, aligned to a page. Throws std::bad_alloc on failure
+  virtual void *allocate(size_t size) = 0;
+
+  virtual void deallocate(void *memory, size_t size) = 0;
+
+  // Apply options that do not touch the memory (huge page advice)
+  virtual void advise(void *memory, size_t size) = 0;
+
+  // Apply options that touch the memory (prefault, lock) - pages are first touched by the calling thread
+  virtual void populate(void *memory, size_t size) = 0;
+
+  void prepare(void *memory, const size_t size) {
+    advise(memory, size);
+    populate(memory, size);
+  }
+};
+
+// Allocator mapping anonymous memory, with huge pages, prefaulting and locking applied according to options. Every
+// option degrades gracefully - memory is always usable even if kernel refuses huge pages or locking
+class MappedBufferAllocator : public BufferAllocator {
+public:
+  explicit MappedBufferAllocator(const MemoryOptions &options = {}) : options(options) {}
+
+  void *allocate(const size_t size) override {
+    if (options.huge_pages == HugePages::explicit_pool) {
+      void *memory = mmap(nullptr, round_up(size, huge_page_size), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (memory != MAP_FAILED) {
+        populate(memory, round_up(size, huge_page_size));
+        return memory;
+      }
+    }
+    void *memory = mmap(nullptr, mapped_size(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::bad_alloc{};
+    }
+    prepare(memory, mapped_size(size));
+    return memory;
+  }
+
+  void deallocate(void *memory, const size_t size) override {
+    // Huge page mappings have to be unmapped in whole huge pages, the rounding is harmless for regular ones
+    munmap(memory, options.huge_pages == HugePages::explicit_pool ? round_up(size, huge_page_size) : mapped_size(size));
+  }
+
+  void advise(void *memory, const size_t size) override {
+    if (options.huge_pages != HugePages::none) {
+      madvise(memory, size, MADV_HUGEPAGE);
+    }
+  }
+
+  void populate(void *memory, const size_t size) override {
+    if (options.prefault) {
+      prefault(memory, size);
+    }
+    if (options.lock) {
+      mlock(memory, size);
+    }
+  }
+
+  const MemoryOptions &get_options() const {
+    return options;
+  }
+
+private:
+  static size_t round_up(const size_t size, const size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  // Transparent huge pages are used only by whole aligned huge pages of the range
+  size_t mapped_size(const size_t size) const {
+    return options.huge_pages == HugePages::none ? round_up(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)))
+                                                 : round_up(size, huge_page_size);
+  }
+
+  static void prefault(void *memory, const size_t size) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(memory, size, MADV_POPULATE_WRITE) == 0) {
+      return;
+    }
+#endif
+    // Kernels before 5.14 - write every page, keeping its content
+    const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto *bytes = static_cast<volatile uint8_t *>(memory);
+    for (size_t offset = 0; offset < size; offset += page_size) {
+      bytes[offset] = bytes[offset];
+    }
+  }
+
+  MemoryOptions options;
+};
+
+inline BufferAllocator &default_allocator() {
+  static MappedBufferAllocator allocator{};
+  return allocator;
+}
+
+}
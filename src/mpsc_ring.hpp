@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <protocol.hpp>
+#include <spsc_ring.hpp>
+
+namespace log4tiny {
+
+// Multiple producer single consumer ring of variable-length records, shared by all threads of a process instead of a
+// ring per thread. Based on Vyukov's bounded array queue, but instead of a sequence number per fixed-size cell every
+// record carries its own publication mark - the length field of its header, which stays 0 until the producer commits
+// the record. Producers claim space with CAS on the write index and fill it in parallel; consumer reads published
+// records in order and zeroes the memory it releases, so that space not committed yet always reads as length 0.
+// Uses the same RingControl and data layout as SpscRing. Data area has to be zeroed initially.
+class MpscRing {
+public:
+  MpscRing() = default;
+
+  MpscRing(RingControl *control, uint8_t *data, const size_t capacity)
+          : control(control), data(data), capacity(capacity) {}
+
+  // Producer side, safe to call from any thread: return pointer to contiguous space for record of given (aligned)
+  // length or nullptr when ring is full. Record becomes visible to consumer once commit() writes its length
+  uint8_t *reserve(const size_t length) {
+    uint64_t write_index = control->write_index.load(std::memory_order_relaxed);
+    size_t offset;
+    size_t padding;
+    do {
+      offset = write_index & (capacity - 1);
+      const size_t space_till_end = capacity - offset;
+      padding = length <= space_till_end ? 0 : space_till_end;
+      if (write_index + padding + length - control->read_index.load(std::memory_order_acquire) > capacity) {
+        return nullptr;
+      }
+    } while (not control->write_index.compare_exchange_weak(write_index, write_index + padding + length,
+                                                            std::memory_order_relaxed));
+
+    if (padding != 0) {
+      const auto kind = protocol::RecordKind::padding;
+      std::memcpy(data + offset + offsetof(protocol::RecordHeader, kind), &kind, sizeof(kind));
+      publish(data + offset, padding);
+      return data;
+    }
+    return data + offset;
+  }
+
+  // Record has to be complete except its length - writing the length publishes it. Every record is published on its
+  // own, so unlike with SpscRing publication cannot be deferred
+  void commit(uint8_t *record, const size_t length, [[maybe_unused]] const bool publish_now = true) {
+    publish(record, length);
+  }
+
+  void publish() {}
+
+  // Bytes reserved and not yet released
+  size_t get_occupancy() const {
+    // Read index is loaded first, so it cannot be ahead of the write index
+    const uint64_t read_index = control->read_index.load(std::memory_order_acquire);
+    return control->write_index.load(std::memory_order_relaxed) - read_index;
+  }
+
+  // Consumer side: return published records that are contiguous in memory. May contain padding records
+  std::span<const uint8_t> readable() const {
+    const uint64_t read_index = control->read_index.load(std::memory_order_relaxed);
+    const size_t offset = read_index & (capacity - 1);
+    size_t length{0};
+    while (offset + length < capacity) {
+      const auto record_length = length_of(data + offset + length);
+      if (record_length == 0) {
+        break;
+      }
+      length += record_length;
+    }
+    return {data + offset, length};
+  }
+
+  void release(const size_t length) {
+    const uint64_t read_index = control->read_index.load(std::memory_order_relaxed);
+    std::memset(data + (read_index & (capacity - 1)), 0, length);
+    control->read_index.store(read_index + length, std::memory_order_release);
+  }
+
+  bool empty() const {
+    return readable().empty();
+  }
+
+  size_t get_capacity() const {
+    return capacity;
+  }
+
+private:
+  static void publish(uint8_t *record, const size_t length) {
+    std::atomic_ref{*reinterpret_cast<uint32_t *>(record + offsetof(protocol::RecordHeader, length))}
+            .store(static_cast<uint32_t>(length), std::memory_order_release);
+  }
+
+  static uint32_t length_of(uint8_t *record) {
+    return std::atomic_ref{*reinterpret_cast<uint32_t *>(record + offsetof(protocol::RecordHeader, length))}
+            .load(std::memory_order_acquire);
+  }
+
+  RingControl *control{nullptr};
+  uint8_t *data{nullptr};
+  size_t capacity{0};
+};
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace log4tiny::numa {
+
+// Minimal NUMA support based on sysfs and raw system calls, so that no libnuma is needed. All functions are best-effort:
+// on machines (or containers) without NUMA information they report a single node 0 and binding memory is a no-op.
+
+// Parse list in sysfs format, e.g. "0-3,8,10-11"
+inline std::vector<unsigned> parse_list(const std::string &list) {
+  std::vector<unsigned> values{};
+  size_t position{0};
+  while (position < list.size()) {
+    unsigned first{0};
+    unsigned last{0};
+    int consumed{0};
+    if (std::sscanf(list.c_str() + position, "%u-%u%n", &first, &last, &consumed) == 2 or
+        std::sscanf(list.c_str() + position, "%u%n", &first, &consumed) == 1) {
+      last = std::max(first, last);
+      for (unsigned value = first; value <= last; ++value) {
+        values.push_back(value);
+      }
+      position += static_cast<size_t>(consumed);
+    }
+    position = list.find(',', position);
+    position = position == std::string::npos ? list.size() : position + 1;
+  }
+  return values;
+}
+
+inline std::string read_sysfs(const std::string &path) {
+  std::string content{};
+  if (FILE *file = std::fopen(path.c_str(), "r")) {
+    char buffer[4096];
+    content.assign(buffer, std::fread(buffer, 1, sizeof(buffer), file));
+    std::fclose(file);
+  }
+  while (not content.empty() and (content.back() == '\n' or content.back() == ' ')) {
+    content.pop_back();
+  }
+  return content;
+}
+
+// Number of nodes, counting from 0 up to the highest online node
+inline int node_count() {
+  const auto nodes = parse_list(read_sysfs("/sys/devices/system/node/online"));
+  return nodes.empty() ? 1 : static_cast<int>(nodes.back()) + 1;
+}
+
+// Node of the CPU the calling thread runs on, -1 when not known
+inline int current_node() {
+  unsigned cpu{0};
+  unsigned node{0};
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return -1;
+  }
+  return static_cast<int>(node);
+}
+
+// Node of given CPU, -1 when not known
+inline int node_of_cpu(const unsigned cpu) {
+  DIR *directory = opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+  if (directory == nullptr) {
+    return -1;
+  }
+  int node{-1};
+  while (const dirent *entry = readdir(directory)) {
+    if (std::sscanf(entry->d_name, "node%d", &node) == 1) {
+      break;
+    }
+  }
+  closedir(directory);
+  return node;
+}
+
+inline std::vector<unsigned> cpus_of_node(const int node) {
+  return parse_list(read_sysfs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+}
+
+// Prefer given node for pages of the memory range. Pages that are not touched yet are allocated on the node when first
+// written, pages already present are moved when possible (only pages not mapped by other processes can be moved)
+inline bool bind_to_node(void *address, const size_t length, const int node) {
+  if (node < 0 or node >= static_cast<int>(8 * sizeof(unsigned long))) {
+    return false;
+  }
+  const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const auto begin = reinterpret_cast<uintptr_t>(address) & ~(page_size - 1);
+  const auto end = reinterpret_cast<uintptr_t>(address) + length;
+  const unsigned long node_mask = 1UL << node;
+  return syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, &node_mask, 8 * sizeof(node_mask), MPOL_MF_MOVE) == 0;
+}
+
+// Restrict calling thread to CPUs of given node
+inline bool pin_thread_to_node(const int node) {
+  cpu_set_t cpus{};
+  for (const auto cpu: cpus_of_node(node)) {
+    CPU_SET(cpu, &cpus);
+  }
+  return CPU_COUNT(&cpus) != 0 and sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace log4tiny {
+
+// Futex operations on a word that may be placed in shared memory, so that producer and consumer can live in different
+// processes - hence no FUTEX_PRIVATE_FLAG
+inline void futex_wait(std::atomic<uint32_t> &word, const uint32_t expected, const std::chrono::nanoseconds timeout) {
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+  const timespec relative{.tv_sec = static_cast<time_t>(timeout.count() / 1'000'000'000),
+          .tv_nsec = static_cast<long>(timeout.count() % 1'000'000'000)};
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &relative, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t> &word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Producer side of the wakeup protocol: wake the consumer if it has declared itself asleep. While consumer is awake,
+// this is a single load of a cache line that consumer does not write, so it stays shared and cheap to read
+inline void wake_consumer(std::atomic<uint32_t> &consumer_sleeping) {
+  if (consumer_sleeping.load(std::memory_order_relaxed) != 0 and
+      consumer_sleeping.exchange(0, std::memory_order_relaxed) != 0) {
+    futex_wake(consumer_sleeping);
+  }
+}
+
+struct PollingOptions {
+  // Empty polls spent spinning, then yielding the CPU, before the consumer goes to sleep
+  uint32_t spin_polls{256};
+  uint32_t yield_polls{64};
+  // Upper bound of a sleep. Producers do not order their check of the sleeping flag against publication of records
+  // (that would take a full fence per record), so a wakeup may be missed - it then costs at most this much latency
+  std::chrono::nanoseconds max_sleep{std::chrono::milliseconds(10)};
+};
+
+// Idle strategy of a consumer polling rings: spin while records are flowing, then back off by yielding and finally
+// sleep on a futex that producers wake (see wake_consumer()). Call reset() after every poll that found records and
+// idle() after every one that did not
+class AdaptivePoller {
+public:
+  explicit AdaptivePoller(std::atomic<uint32_t> &consumer_sleeping, const PollingOptions &options = {})
+          : consumer_sleeping(consumer_sleeping), options(options) {}
+
+  void reset() {
+    empty_polls = 0;
+  }
+
+  // Wait before the next poll. Function is called after the consumer has declared itself asleep and has to tell
+  // whether any records have been published meanwhile - producer that published them may have seen consumer awake
+  template<typename Function>
+  void idle(Function &&has_records) {
+    ++empty_polls;
+    if (empty_polls <= options.spin_polls) {
+      pause();
+      return;
+    }
+    if (empty_polls <= options.spin_polls + options.yield_polls) {
+      std::this_thread::yield();
+      return;
+    }
+    consumer_sleeping.store(1, std::memory_order_seq_cst);
+    if (not has_records()) {
+      futex_wait(consumer_sleeping, 1, options.max_sleep);
+    }
+    consumer_sleeping.store(0, std::memory_order_relaxed);
+  }
+
+  // Whether consumer is still in the spinning phase, i.e. records stopped flowing only moments ago
+  bool is_spinning() const {
+    return empty_polls < options.spin_polls;
+  }
+
+private:
+  static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  std::atomic<uint32_t> &consumer_sleeping;
+  PollingOptions options;
+  uint32_t empty_polls{0};
+};
+
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#ifdef __GLIBC_HAVE_KERNEL_RSEQ
+#define LOG4TINY_HAVE_RSEQ
+#endif
+#endif
+#include <backtrace.hpp>
+#include <mpsc_ring.hpp>
+#include <polling.hpp>
+#include <spsc_ring.hpp>
+#include <statistics.hpp>
+
+namespace log4tiny {
+
+// Producer mode is selected at compile time:
+// - by default every thread writes to its own SPSC ring,
+// - with LOG4TINY_MPSC_QUEUE all threads share a single MPSC ring - memory does not grow with number of threads, which
+//   suits many short-lived threads, at the cost of producers contending on the write index,
+// - with LOG4TINY_PER_CPU_RINGS threads write to the ring of CPU they run on, found through the rseq area registered by
+//   glibc, so memory scales with number of cores. Thread may be migrated between reading its CPU and committing the
+//   record, hence per-CPU rings are MPSC rings too - contention is just rare. Without rseq, every thread gets its own
+//   ring as in the default mode.
+enum class ProducerMode {
+  per_thread_rings,
+  shared_ring,
+  per_cpu_rings
+};
+
+#if defined(LOG4TINY_MPSC_QUEUE)
+using ProducerRing = MpscRing;
+inline constexpr ProducerMode producer_mode = ProducerMode::shared_ring;
+#elif defined(LOG4TINY_PER_CPU_RINGS)
+using ProducerRing = MpscRing;
+inline constexpr ProducerMode producer_mode = ProducerMode::per_cpu_rings;
+#else
+using ProducerRing = SpscRing;
+inline constexpr ProducerMode producer_mode = ProducerMode::per_thread_rings;
+#endif
+
+// Provider of rings for producer threads (i.e. a transport). Each thread acquires its ring on first tinylog call and
+// gives it back when the thread exits. When no source is installed or it has no ring available, records are dropped.
+class RingSource {
+public:
+  virtual ~RingSource() = default;
+
+  virtual ProducerRing *acquire_ring() = 0;
+
+  virtual void release_ring(ProducerRing *ring) = 0;
+
+  // Rings indexed by CPU number, when the source provides per-CPU rings (LOG4TINY_PER_CPU_RINGS and rseq available).
+  // Threads then write to these rings and do not acquire rings of their own
+  virtual std::span<ProducerRing> get_cpu_rings() {
+    return {};
+  }
+
+  // Futex word the consumer of the rings sleeps on when idle (see AdaptivePoller), nullptr when consumer never sleeps
+  virtual std::atomic<uint32_t> *get_consumer_sleeping() {
+    return nullptr;
+  }
+};
+
+namespace detail {
+
+inline std::atomic<RingSource *> ring_source{nullptr};
+// Incremented every time ring source changes, so that threads drop rings of previous source (and emit site records
+// again, as the new source leads to a new stream)
+inline std::atomic<uint64_t> ring_source_epoch{1};
+inline std::atomic<uint32_t> next_site_id{0};
+inline std::atomic<uint32_t> next_thread_id{0};
+
+// CPU the calling thread runs on, read from the rseq area that glibc registers for every thread. Returns -1 when rseq is
+// not available
+inline int current_cpu() {
+#ifdef LOG4TINY_HAVE_RSEQ
+  if (__rseq_size == 0) {
+    return -1;
+  }
+  const auto *area = reinterpret_cast<const volatile struct rseq *>(
+          static_cast<const char *>(__builtin_thread_pointer()) + __rseq_offset);
+  return static_cast<int32_t>(area->cpu_id);
+#else
+  return -1;
+#endif
+}
+
+struct ThreadContext {
+  ThreadContext() {
+    register_counters(counters);
+  }
+
+  ThreadContext(const ThreadContext &) = delete;
+
+  ThreadContext &operator=(const ThreadContext &) = delete;
+
+  ~ThreadContext() {
+    if (ring != nullptr and epoch == ring_source_epoch.load(std::memory_order_acquire)) {
+      ring->publish();
+      source->release_ring(ring);
+    }
+    unregister_counters(counters);
+  }
+
+  // Make sure that thread holds a ring of currently installed source. Acquisition is attempted once per source, so
+  // threads that did not get a ring do not pay for it on every call
+  bool ensure_ring() {
+    const auto current_epoch = ring_source_epoch.load(std::memory_order_acquire);
+    if (epoch == current_epoch) {
+      return ring != nullptr or not cpu_rings.empty();
+    }
+    epoch = current_epoch;
+    source = ring_source.load(std::memory_order_acquire);
+    ring = nullptr;
+    consumer_sleeping = source != nullptr ? source->get_consumer_sleeping() : nullptr;
+    if constexpr (producer_mode == ProducerMode::per_cpu_rings) {
+      cpu_rings = source != nullptr ? source->get_cpu_rings() : std::span<ProducerRing>{};
+    }
+    if (cpu_rings.empty() and source != nullptr) {
+      ring = source->acquire_ring();
+    }
+    return ring != nullptr or not cpu_rings.empty();
+  }
+
+  // Ring to write the next record to
+  ProducerRing *current_ring() const {
+    if constexpr (producer_mode == ProducerMode::per_cpu_rings) {
+      if (not cpu_rings.empty()) {
+        return &cpu_rings[static_cast<uint32_t>(current_cpu()) % cpu_rings.size()];
+      }
+    }
+    return ring;
+  }
+
+  // Publish records committed within a batch (see RecordBatch). Ring of a source that has been replaced meanwhile is
+  // not touched, as the source may be gone already
+  void publish() const {
+    if (ring != nullptr and epoch == ring_source_epoch.load(std::memory_order_acquire)) {
+      ring->publish();
+      wake_consumer();
+    }
+  }
+
+  // To be called after records are published
+  void wake_consumer() const {
+    if (consumer_sleeping != nullptr) {
+      ::log4tiny::wake_consumer(*consumer_sleeping);
+    }
+  }
+
+  ProducerRing *ring{nullptr};
+  std::span<ProducerRing> cpu_rings{};
+  RingSource *source{nullptr};
+  std::atomic<uint32_t> *consumer_sleeping{nullptr};
+  uint64_t epoch{0};
+  uint32_t thread_id{next_thread_id.fetch_add(1, std::memory_order_relaxed)};
+  ProducerCounters counters{};
+  // Depth of nested RecordBatch scopes - records are published only outside of them
+  uint32_t batch_depth{0};
+  // Last debug records of the thread (see Level)
+  BacktraceBuffer backtrace{};
+};
+
+inline ThreadContext &thread_context() {
+  static thread_local ThreadContext context{};
+  return context;
+}
+
+inline uint64_t timestamp_now() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+}
+
+// Install source of rings for producer threads. Threads holding ring of previous source drop it on their next call
+inline void set_ring_source(RingSource *source) {
+  detail::ring_source.store(source, std::memory_order_release);
+  detail::ring_source_epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// Uninstall given source if it is the current one - to be called by source before it is destroyed
+inline void reset_ring_source(RingSource *source) {
+  if (detail::ring_source.load(std::memory_order_acquire) == source) {
+    set_ring_source(nullptr);
+  }
+}
+
+}
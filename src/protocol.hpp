@@ -0,0 +1,357 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <codec.hpp>
+
+namespace log4tiny::protocol {
+
+// Binary stream produced by the library is a sequence of records, each starting with RecordHeader and padded to
+// record_alignment so that headers can be read in place. Site records describe a call site (file, line, format and
+// types of arguments) and are emitted by every producer thread before its first log record of given site. Thanks to
+// that a stream drained from a single producer can always be decoded on its own, regardless of how streams of
+// different producers are interleaved later. This header is shared between the library, the agent and the decoder.
+
+inline constexpr uint32_t file_magic = 0x5954344CU; // "L4TY"
+inline constexpr uint32_t protocol_version = 5;
+inline constexpr size_t record_alignment = 8;
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+enum class RecordKind : uint16_t {
+  padding = 0,
+  site = 1,
+  log = 2,
+  chunk_index = 3
+};
+
+enum class ArgumentType : uint8_t {
+  signed_int = 0,
+  unsigned_int = 1,
+  floating = 2,
+  character = 3,
+  string = 4,
+  pointer = 5,
+  // Bytes of a value of user type (see codec), size is given by the site record
+  user = 6,
+  // Floating point value XOR coded against the previous value of the same column (see XorStreamPrefix), takes no bytes
+  // of its own among the arguments
+  xor_floating = 7
+};
+
+// Level of a call site (see tinylog_debug and tinylog_error), plain tinylog sites are info
+enum class Level : uint16_t {
+  info = 0,
+  debug = 1,
+  error = 2
+};
+
+struct RecordHeader {
+  uint32_t length; // Length of the whole record including header and alignment padding
+  RecordKind kind;
+  uint16_t reserved;
+  uint32_t site_id;
+  uint32_t thread_id;
+  uint64_t timestamp; // Nanoseconds since epoch
+};
+
+static_assert(sizeof(RecordHeader) == 24);
+static_assert(sizeof(RecordHeader) % record_alignment == 0);
+
+// Payload of site record, followed by argument_count ArgumentType values, file name, format string and description of
+// every argument of user type: uint16_t size of its values, uint16_t length of codec name and the name
+struct SiteDescriptor {
+  uint32_t file_hash;
+  uint32_t line;
+  uint16_t argument_count;
+  uint16_t file_length;
+  uint32_t format_length;
+  // Site logs 1 in sampling_rate calls (see tinylog_sampled), 1 when it is not sampled
+  uint32_t sampling_rate;
+  Level level;
+  // Bytes of user type descriptions
+  uint16_t codec_length;
+};
+
+// Prefix of log records of sites with XOR coded floating point arguments (see tinylog_xor_floats). It is followed by
+// the other arguments as usual and then by the bit stream of XOR coded values (see compression::XorFloatEncoder) in
+// order of arguments, padded to a whole byte. Coded values depend on the previous record of the stream - records of
+// the site written by one thread to one ring (stream is the index of the ring in per CPU mode, 0 otherwise). Sequence
+// counts records of the stream from the last key record, whose values are coded from scratch, so that decoder can tell
+// a record is missing and pick the stream up again at the next key record.
+struct XorStreamPrefix {
+  uint16_t stream;
+  uint16_t sequence;
+};
+
+// Every stream starts over with a key record at least this often
+inline constexpr uint16_t xor_key_interval = 32;
+
+// Payload of chunk index record. Chunk index records are stored in a sidecar file next to the binary log and describe
+// byte range of every chunk (batch) written to the log together with the range of timestamps of its records
+struct ChunkIndexEntry {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t min_timestamp;
+  uint64_t max_timestamp;
+};
+
+constexpr size_t align_record_length(const size_t length) {
+  return (length + record_alignment - 1) & ~(record_alignment - 1);
+}
+
+template<typename T>
+concept StringArgument = std::same_as<T, std::string> or std::same_as<T, std::string_view> or
+                         std::same_as<T, const char *> or std::same_as<T, char *>;
+
+template<typename T>
+concept CharacterArgument = std::same_as<T, char> or std::same_as<T, unsigned char> or std::same_as<T, signed char>;
+
+template<typename T>
+concept EncodableArgument = CharacterArgument<T> or std::integral<T> or std::floating_point<T> or
+                            StringArgument<T> or std::is_pointer_v<T> or CodecArgument<T>;
+
+// Argument type is derived from C++ type of the argument rather than from the placeholder, so that decoder always
+// knows how to read the value. Placeholder only decides how the value is rendered.
+template<typename T>
+requires EncodableArgument<std::decay_t<T>>
+constexpr ArgumentType argument_type_of() {
+  using Type = std::decay_t<T>;
+  if constexpr (CodecArgument<Type>) {
+    return ArgumentType::user;
+  } else if constexpr (CharacterArgument<Type>) {
+    return ArgumentType::character;
+  } else if constexpr (std::signed_integral<Type>) {
+    return ArgumentType::signed_int;
+  } else if constexpr (std::integral<Type>) {
+    return ArgumentType::unsigned_int;
+  } else if constexpr (std::floating_point<Type>) {
+    return ArgumentType::floating;
+  } else if constexpr (StringArgument<Type>) {
+    return ArgumentType::string;
+  } else {
+    return ArgumentType::pointer;
+  }
+}
+
+template<typename T>
+std::string_view as_string_view(const T &argument) {
+  if constexpr (std::is_pointer_v<T>) {
+    return argument != nullptr ? std::string_view{argument} : std::string_view{"(null)"};
+  } else {
+    return std::string_view{argument};
+  }
+}
+
+// Number of bytes taken by encoded argument. Strings are stored as 32 bit length followed by characters, characters
+// take a single byte, values of user types their own size and all other types are widened to 8 bytes.
+template<typename T>
+size_t encoded_size(const T &argument) {
+  constexpr auto type = argument_type_of<T>();
+  if constexpr (type == ArgumentType::user) {
+    return sizeof(T);
+  } else if constexpr (type == ArgumentType::string) {
+    return sizeof(uint32_t) + as_string_view(argument).size();
+  } else if constexpr (type == ArgumentType::character) {
+    return sizeof(char);
+  } else {
+    return sizeof(uint64_t);
+  }
+}
+
+template<typename T>
+uint8_t *encode_argument(uint8_t *destination, const T &argument) {
+  constexpr auto type = argument_type_of<T>();
+  if constexpr (type == ArgumentType::user) {
+    std::memcpy(destination, &argument, sizeof(T));
+    return destination + sizeof(T);
+  } else if constexpr (type == ArgumentType::string) {
+    const auto string = as_string_view(argument);
+    const auto length = static_cast<uint32_t>(string.size());
+    std::memcpy(destination, &length, sizeof(length));
+    std::memcpy(destination + sizeof(length), string.data(), string.size());
+    return destination + sizeof(length) + string.size();
+  } else if constexpr (type == ArgumentType::character) {
+    *destination = static_cast<uint8_t>(argument);
+    return destination + 1;
+  } else {
+    using WideType = std::conditional_t<type == ArgumentType::signed_int, int64_t,
+            std::conditional_t<type == ArgumentType::floating, double, uint64_t>>;
+    WideType value;
+    if constexpr (type == ArgumentType::pointer) {
+      value = reinterpret_cast<uintptr_t>(argument);
+    } else {
+      value = static_cast<WideType>(argument);
+    }
+    std::memcpy(destination, &value, sizeof(value));
+    return destination + sizeof(value);
+  }
+}
+
+struct ArgumentValue {
+  ArgumentType type;
+  union {
+    int64_t signed_int;
+    uint64_t unsigned_int;
+    double floating;
+    char character;
+  };
+  // Characters of string, encoded bytes of user type value
+  std::string_view string;
+  // Renderer of user type value, nullptr when not known
+  CodecRenderer renderer{nullptr};
+};
+
+// Read single argument of given type and advance cursor past it. Size of user type values is not known here, see
+// decode_user_argument()
+inline ArgumentValue decode_argument(const ArgumentType type, const uint8_t *&cursor) {
+  ArgumentValue value{.type = type, .unsigned_int = 0, .string = {}};
+  switch (type) {
+    case ArgumentType::string: {
+      uint32_t length;
+      std::memcpy(&length, cursor, sizeof(length));
+      value.string = std::string_view{reinterpret_cast<const char *>(cursor + sizeof(length)), length};
+      cursor += sizeof(length) + length;
+      break;
+    }
+    case ArgumentType::character:
+      value.character = static_cast<char>(*cursor);
+      cursor += 1;
+      break;
+    default:
+      std::memcpy(&value.unsigned_int, cursor, sizeof(uint64_t));
+      cursor += sizeof(uint64_t);
+      break;
+  }
+  return value;
+}
+
+inline ArgumentValue decode_user_argument(const uint8_t *&cursor, const size_t size, const CodecRenderer renderer) {
+  ArgumentValue value{.type = ArgumentType::user, .unsigned_int = 0,
+          .string = {reinterpret_cast<const char *>(cursor), size}, .renderer = renderer};
+  cursor += size;
+  return value;
+}
+
+// Value of the argument exactly as decoder sees it after encoding, for rendering arguments in the producer process
+template<typename T>
+ArgumentValue make_argument_value(const T &argument) {
+  constexpr auto type = argument_type_of<T>();
+  ArgumentValue value{.type = type, .unsigned_int = 0, .string = {}};
+  if constexpr (type == ArgumentType::user) {
+    value.string = {reinterpret_cast<const char *>(&argument), sizeof(T)};
+    value.renderer = codec_renderer<T>();
+  } else if constexpr (type == ArgumentType::string) {
+    value.string = as_string_view(argument);
+  } else if constexpr (type == ArgumentType::character) {
+    value.character = static_cast<char>(argument);
+  } else if constexpr (type == ArgumentType::signed_int) {
+    value.signed_int = static_cast<int64_t>(argument);
+  } else if constexpr (type == ArgumentType::floating) {
+    value.floating = static_cast<double>(argument);
+  } else if constexpr (type == ArgumentType::pointer) {
+    value.unsigned_int = reinterpret_cast<uintptr_t>(argument);
+  } else {
+    value.unsigned_int = static_cast<uint64_t>(argument);
+  }
+  return value;
+}
+
+template<typename T>
+constexpr size_t codec_description_length() {
+  if constexpr (argument_type_of<T>() == ArgumentType::user) {
+    return 2 * sizeof(uint16_t) + std::string_view{codec<std::decay_t<T>>::name}.size();
+  } else {
+    return 0;
+  }
+}
+
+template<typename T>
+uint8_t *write_codec_description(uint8_t *destination) {
+  if constexpr (argument_type_of<T>() == ArgumentType::user) {
+    // Size is stored in 16 bits, as it has to fit the record anyway
+    static_assert(sizeof(T) <= std::numeric_limits<uint16_t>::max(), "codec type too large to be logged");
+    const std::string_view name = codec<std::decay_t<T>>::name;
+    const uint16_t description[] = {static_cast<uint16_t>(sizeof(T)), static_cast<uint16_t>(name.size())};
+    std::memcpy(destination, description, sizeof(description));
+    std::memcpy(destination + sizeof(description), name.data(), name.size());
+    return destination + sizeof(description) + name.size();
+  } else {
+    return destination;
+  }
+}
+
+template<typename... T>
+constexpr size_t site_record_length(const std::string_view &file, const std::string_view &format) {
+  return align_record_length(sizeof(RecordHeader) + sizeof(SiteDescriptor) + sizeof...(T) + file.size() + format.size() +
+                             (codec_description_length<T>() + ... + 0));
+}
+
+// Write header except its length. Length is written last, by commit() of the ring, as in a shared ring it is what
+// publishes the record to the consumer
+inline void write_record_header(uint8_t *destination, const RecordHeader &header) {
+  static_assert(offsetof(RecordHeader, length) == 0);
+  constexpr size_t skipped = sizeof(RecordHeader::length);
+  std::memcpy(destination + skipped, reinterpret_cast<const uint8_t *>(&header) + skipped, sizeof(header) - skipped);
+}
+
+// Type of argument as recorded in site record - floating point arguments of sites with XOR coded values are marked as
+// such
+template<typename T>
+constexpr ArgumentType site_argument_type_of(const bool xor_floats) {
+  constexpr auto type = argument_type_of<T>();
+  return xor_floats and type == ArgumentType::floating ? ArgumentType::xor_floating : type;
+}
+
+// Write site record describing call site with arguments of types T... Destination has to hold at least
+// site_record_length<T...>(file, format) bytes. Length of the record is left to be written by commit() (see
+// write_record_header())
+template<typename... T>
+void write_site_record(uint8_t *destination, const RecordHeader &header, const uint32_t file_hash, const uint32_t line,
+                       const std::string_view &file, const std::string_view &format, const uint32_t sampling_rate = 1,
+                       const Level level = Level::info, [[maybe_unused]] const bool xor_floats = false) {
+  const ArgumentType argument_types[] = {site_argument_type_of<T>(xor_floats)..., ArgumentType{}};
+  const SiteDescriptor descriptor{.file_hash = file_hash, .line = line,
+          .argument_count = static_cast<uint16_t>(sizeof...(T)),
+          .file_length = static_cast<uint16_t>(file.size()),
+          .format_length = static_cast<uint32_t>(format.size()), .sampling_rate = sampling_rate, .level = level,
+          .codec_length = static_cast<uint16_t>((codec_description_length<T>() + ... + 0))};
+  write_record_header(destination, header);
+  auto *cursor = destination + sizeof(header);
+  std::memcpy(cursor, &descriptor, sizeof(descriptor));
+  cursor += sizeof(descriptor);
+  std::memcpy(cursor, argument_types, sizeof...(T));
+  cursor += sizeof...(T);
+  std::memcpy(cursor, file.data(), file.size());
+  cursor += file.size();
+  std::memcpy(cursor, format.data(), format.size());
+  cursor += format.size();
+  ((cursor = write_codec_description<T>(cursor)), ...);
+}
+
+// Iterate over complete records in given span skipping padding records
+template<typename Function>
+void for_each_record(std::span<const uint8_t> records, Function &&function) {
+  while (not records.empty()) {
+    uint32_t length;
+    RecordKind kind;
+    std::memcpy(&length, records.data() + offsetof(RecordHeader, length), sizeof(length));
+    std::memcpy(&kind, records.data() + offsetof(RecordHeader, kind), sizeof(kind));
+    if (kind != RecordKind::padding) {
+      function(records.first(length));
+    }
+    records = records.subspan(length);
+  }
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace log4tiny {
+
+// Token bucket of a single call site (see tinylog_rate_limited), shared by all threads calling the site. Implemented as
+// generic cell rate algorithm: instead of a token count, bucket keeps the earliest time the next record is allowed, so
+// that a suppressed call costs a single comparison of its timestamp - it only reads the shared bucket. Suppressed calls
+// are counted by the caller in a counter of its own thread, so a storm does not make threads contend on the bucket.
+// Bucket allows bursts of given size and refills at given rate.
+class RateLimiter {
+public:
+  RateLimiter(const uint64_t records_per_second, const uint64_t burst)
+          : interval(1'000'000'000 / (records_per_second != 0 ? records_per_second : 1)),
+            tolerance(interval * (burst != 0 ? burst - 1 : 0)) {}
+
+  RateLimiter(const RateLimiter &) = delete;
+
+  RateLimiter &operator=(const RateLimiter &) = delete;
+
+  // Try to take a token at given time (nanoseconds). Returns std::nullopt when the record has to be suppressed and
+  // counts it in given counter of the calling thread. Otherwise returns (and resets) that counter - number of records
+  // of the thread suppressed since its last allowed one, to be reported by the caller
+  std::optional<uint64_t> acquire(const uint64_t now, uint64_t &suppressed) {
+    uint64_t allowed_from = next_allowed.load(std::memory_order_relaxed);
+    if (now < allowed_from) {
+      ++suppressed;
+      return std::nullopt;
+    }
+    // Theoretical arrival time of the next record is allowed_from + tolerance. Bucket does not save up tokens for
+    // more than one burst while idle
+    uint64_t next;
+    do {
+      if (now < allowed_from) {
+        ++suppressed;
+        return std::nullopt;
+      }
+      next = std::max(allowed_from + tolerance, now) + interval - tolerance;
+    } while (not next_allowed.compare_exchange_weak(allowed_from, next, std::memory_order_relaxed));
+    return std::exchange(suppressed, 0);
+  }
+
+private:
+  uint64_t interval;
+  uint64_t tolerance;
+  std::atomic<uint64_t> next_allowed{0};
+};
+
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include <crc32.hpp>
+#include <decoder.hpp>
+#include <protocol.hpp>
+
+namespace log4tiny::decoder {
+
+enum class Comparison {
+  equal,
+  not_equal,
+  less,
+  less_or_equal,
+  greater,
+  greater_or_equal
+};
+
+// Predicate on a single argument of a record, e.g. "arg0 > 500" or "arg2 == text"
+struct ArgumentPredicate {
+  size_t argument_index;
+  Comparison comparison;
+  std::variant<int64_t, double, std::string> value;
+};
+
+// Parse "arg<index> <comparison> <value>". Value is an integer, a floating point number or (otherwise) a string
+inline std::optional<ArgumentPredicate> parse_argument_predicate(std::string_view text) {
+  const auto skip_spaces = [&text] {
+    while (not text.empty() and text.front() == ' ') {
+      text.remove_prefix(1);
+    }
+  };
+
+  skip_spaces();
+  if (not text.starts_with("arg")) {
+    return std::nullopt;
+  }
+  text.remove_prefix(3);
+  size_t argument_index{0};
+  const auto [index_end, index_error] = std::from_chars(text.data(), text.data() + text.size(), argument_index);
+  if (index_error != std::errc{}) {
+    return std::nullopt;
+  }
+  text.remove_prefix(static_cast<size_t>(index_end - text.data()));
+  skip_spaces();
+
+  static constexpr std::pair<std::string_view, Comparison> comparisons[] = {
+          {"==", Comparison::equal}, {"!=", Comparison::not_equal}, {"<=", Comparison::less_or_equal},
+          {">=", Comparison::greater_or_equal}, {"<", Comparison::less}, {">", Comparison::greater},
+          {"=", Comparison::equal}};
+  const auto comparison = std::ranges::find_if(comparisons, [&text](const auto &entry) { return text.starts_with(entry.first); });
+  if (comparison == std::end(comparisons)) {
+    return std::nullopt;
+  }
+  text.remove_prefix(comparison->first.size());
+  skip_spaces();
+
+  ArgumentPredicate predicate{.argument_index = argument_index, .comparison = comparison->second, .value = std::string{text}};
+  int64_t integer{0};
+  double floating{0.0};
+  if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), integer);
+          error == std::errc{} and end == text.data() + text.size()) {
+    predicate.value = integer;
+  } else if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), floating);
+          error == std::errc{} and end == text.data() + text.size()) {
+    predicate.value = floating;
+  }
+  return predicate;
+}
+
+template<typename T>
+bool compare(const T &left, const Comparison comparison, const T &right) {
+  switch (comparison) {
+    case Comparison::equal:
+      return left == right;
+    case Comparison::not_equal:
+      return left != right;
+    case Comparison::less:
+      return left < right;
+    case Comparison::less_or_equal:
+      return left <= right;
+    case Comparison::greater:
+      return left > right;
+    default:
+      return left >= right;
+  }
+}
+
+// Values of user types (see codec) are opaque bytes to the filter and match no predicate
+inline bool evaluate(const ArgumentPredicate &predicate, const protocol::ArgumentValue &argument) {
+  if (const auto *string = std::get_if<std::string>(&predicate.value)) {
+    return argument.type == protocol::ArgumentType::string and
+           compare(argument.string, predicate.comparison, std::string_view{*string});
+  }
+  if (argument.type == protocol::ArgumentType::string or argument.type == protocol::ArgumentType::user) {
+    return false;
+  }
+  if (const auto *integer = std::get_if<int64_t>(&predicate.value); integer and argument.type != protocol::ArgumentType::floating) {
+    if (argument.type == protocol::ArgumentType::unsigned_int or argument.type == protocol::ArgumentType::pointer) {
+      // Negative value is smaller than any unsigned argument
+      return *integer < 0 ? compare(1, predicate.comparison, 0)
+                          : compare(argument.unsigned_int, predicate.comparison, static_cast<uint64_t>(*integer));
+    }
+    return compare(as_signed(argument), predicate.comparison, *integer);
+  }
+  const double value = std::holds_alternative<double>(predicate.value) ? std::get<double>(predicate.value)
+                                                                        : static_cast<double>(std::get<int64_t>(predicate.value));
+  return compare(as_double(argument), predicate.comparison, value);
+}
+
+// Locate argument of given index within the record without decoding preceding arguments. Values of XOR coded arguments
+// are taken from xor_values, as in decode_arguments()
+inline std::optional<protocol::ArgumentValue>
+find_argument(const SiteInfo &site, std::span<const uint8_t> record, const size_t argument_index,
+              std::span<const double> xor_values = {}) {
+  if (argument_index >= site.argument_types.size() or record.size() < arguments_offset(site)) {
+    return std::nullopt;
+  }
+  const uint8_t *cursor = record.data() + arguments_offset(site);
+  const uint8_t *end = record.data() + record.size();
+  size_t user_argument{0};
+  size_t xor_value{0};
+  for (size_t argument = 0; argument <= argument_index; ++argument) {
+    const auto length = stored_argument_length(site, argument, cursor, static_cast<size_t>(end - cursor), user_argument);
+    if (not length) {
+      return std::nullopt;
+    }
+    const auto type = site.argument_types[argument];
+    const bool xor_coded = not site.xor_coded.empty() and site.xor_coded[argument];
+    if (argument == argument_index) {
+      if (xor_coded) {
+        return xor_value < xor_values.size()
+               ? std::optional{protocol::ArgumentValue{.type = type, .floating = xor_values[xor_value], .string = {}}}
+               : std::nullopt;
+      }
+      return type == protocol::ArgumentType::user
+             ? protocol::decode_user_argument(cursor, *length, site.codecs[user_argument - 1].renderer)
+             : protocol::decode_argument(type, cursor);
+    }
+    xor_value += xor_coded ? 1 : 0;
+    cursor += *length;
+  }
+  return std::nullopt;
+}
+
+// Selects records on binary level, before any text is rendered. Conditions on call site (id, file, format) are
+// evaluated once per site and cached, so for most records filtering costs a single hash map lookup. Argument
+// predicates only read arguments they refer to.
+class RecordFilter {
+public:
+  std::optional<uint32_t> site_id{};
+  std::optional<uint32_t> file_hash{};
+  std::optional<std::string> format_substring{};
+  std::vector<ArgumentPredicate> argument_predicates{};
+
+  static uint32_t hash_file(const std::string_view &file) {
+    return compute_crc32(file.data(), static_cast<uint32_t>(file.size()));
+  }
+
+  bool is_empty() const {
+    return not site_id and not file_hash and not format_substring and argument_predicates.empty();
+  }
+
+  bool matches(const protocol::RecordHeader &header, const SiteInfo &site, std::span<const uint8_t> record,
+               std::span<const double> xor_values = {}) {
+    auto [cached, inserted] = site_matches.try_emplace(header.site_id, false);
+    if (inserted) {
+      cached->second = matches_site(header.site_id, site);
+    }
+    if (not cached->second) {
+      return false;
+    }
+    return std::ranges::all_of(argument_predicates, [&](const ArgumentPredicate &predicate) {
+      const auto argument = find_argument(site, record, predicate.argument_index, xor_values);
+      return argument and evaluate(predicate, *argument);
+    });
+  }
+
+  // Has to be called when definition of a site changes
+  void forget_site(const uint32_t id) {
+    site_matches.erase(id);
+  }
+
+private:
+  bool matches_site(const uint32_t id, const SiteInfo &site) const {
+    return (not site_id or *site_id == id) and (not file_hash or *file_hash == site.file_hash) and
+           (not format_substring or site.format.find(*format_substring) != std::string::npos) and
+           std::ranges::all_of(argument_predicates, [&site](const ArgumentPredicate &predicate) {
+             return predicate.argument_index < site.argument_types.size();
+           });
+  }
+
+  std::unordered_map<uint32_t, bool> site_matches{};
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace log4tiny {
+
+// Hash deciding whether records keyed by given value are sampled (see tinylog_sampled_by). It depends on the value only,
+// so that every site and every process sampling by e.g. the same request id keeps or drops the request as a whole
+inline uint64_t sampling_hash(uint64_t value) {
+  // Finalizer of splitmix64 - consecutive ids are spread evenly over residues
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+inline uint64_t sampling_hash(const std::string_view value) {
+  // FNV-1a
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (const char character: value) {
+    hash = (hash ^ static_cast<uint8_t>(character)) * 0x100000001B3ULL;
+  }
+  return sampling_hash(hash);
+}
+
+template<typename T>
+requires std::integral<T> or std::is_enum_v<T>
+uint64_t sampling_hash(const T value) {
+  return sampling_hash(static_cast<uint64_t>(value));
+}
+
+inline uint64_t sampling_hash(const char *value) {
+  return sampling_hash(std::string_view{value});
+}
+
+// Whether record keyed by given value is kept when sampling 1 in rate
+template<typename T>
+bool is_sampled(const T &key, const uint32_t rate) {
+  return sampling_hash(key) % rate == 0;
+}
+
+}
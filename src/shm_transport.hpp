@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory.hpp>
+#include <mpsc_ring.hpp>
+#include <numa.hpp>
+#include <producer.hpp>
+#include <protocol.hpp>
+#include <spsc_ring.hpp>
+
+namespace log4tiny::shm {
+
+// Shared memory segment used to pass records to an out-of-process agent. Application never performs any I/O - it only
+// writes into rings placed in the segment, while the agent drains them. Layout of the segment:
+// [SegmentHeader][SlotHeader x slot_count][ring data x slot_count]
+// Every producer thread claims one slot (one SPSC ring). When thread exits, its slot is retired and agent frees it
+// once all remaining records are drained. In producer modes with shared rings (see ProducerMode), slots hold MPSC rings
+// and the shared ones stay active for the whole life of the segment.
+
+inline constexpr uint32_t segment_magic = 0x4D48534CU; // "LSHM"
+inline constexpr uint32_t segment_version = 4;
+
+enum class SlotState : uint32_t {
+  free = 0,
+  active = 1,
+  retired = 2
+};
+
+enum class QueueKind : uint32_t {
+  spsc = 0,
+  mpsc = 1
+};
+
+struct alignas(cache_line_size) SegmentHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t ring_capacity;
+  uint32_t producer_pid;
+  QueueKind queue_kind;
+  std::atomic<uint32_t> ready; // Set by producer once the whole segment is initialized
+  // Futex word agent sleeps on when there is nothing to drain (see AdaptivePoller). Kept on its own cache line, as
+  // producers read it after every record
+  alignas(cache_line_size) std::atomic<uint32_t> consumer_sleeping;
+};
+
+struct alignas(cache_line_size) SlotHeader {
+  std::atomic<SlotState> state;
+  // NUMA node ring memory is bound to, -1 when not bound. Lets agent drain rings on their own node
+  std::atomic<int32_t> numa_node;
+  RingControl control;
+};
+
+static_assert(std::atomic<SlotState>::is_always_lock_free);
+
+constexpr size_t segment_size(const uint32_t slot_count, const uint32_t ring_capacity) {
+  return sizeof(SegmentHeader) + slot_count * (sizeof(SlotHeader) + static_cast<size_t>(ring_capacity));
+}
+
+// Mapping of the segment, used by both producer and agent
+class Segment {
+public:
+  // Create new segment replacing existing one with the same name. Name has to follow shm_open() rules ("/name"). Mapped
+  // memory is passed to allocator's advise(), headers are populated (prefaulted, locked) right away, rings only once
+  // they are placed by prepare_ring() - allocator has to outlive the segment
+  static Segment create(const std::string &name, const uint32_t slot_count, const uint32_t ring_capacity,
+                        const QueueKind queue_kind = QueueKind::spsc, BufferAllocator &allocator = default_allocator()) {
+    if (ring_capacity == 0 or (ring_capacity & (ring_capacity - 1)) != 0 or ring_capacity % protocol::record_alignment != 0) {
+      throw std::invalid_argument("Ring capacity has to be a power of two");
+    }
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "shm_open");
+    }
+    // Name is removed again when the segment cannot be set up. Descriptor is closed by the segment, or by its
+    // constructor when mapping fails
+    try {
+      const size_t size = segment_size(slot_count, ring_capacity);
+      if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "ftruncate");
+      }
+      Segment segment{fd, size};
+      segment.allocator = &allocator;
+      allocator.advise(segment.memory, size);
+      allocator.populate(segment.memory, sizeof(SegmentHeader) + slot_count * sizeof(SlotHeader));
+
+      // Freshly truncated memory is zeroed, so all slots are free and all indices start at 0
+      auto *header = new(segment.memory) SegmentHeader{.magic = segment_magic, .version = segment_version,
+              .slot_count = slot_count, .ring_capacity = ring_capacity,
+              .producer_pid = static_cast<uint32_t>(getpid()), .queue_kind = queue_kind, .ready = 0,
+              .consumer_sleeping = 0};
+      for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        new(segment.slot_header(slot)) SlotHeader{.state = SlotState::free, .numa_node = -1, .control = {}};
+      }
+      header->ready.store(1, std::memory_order_release);
+      return segment;
+    } catch (...) {
+      shm_unlink(name.c_str());
+      throw;
+    }
+  }
+
+  // Open segment created by producer. Returns std::nullopt when it does not exist or is not initialized yet
+  static std::optional<Segment> open(const std::string &name) {
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      return std::nullopt;
+    }
+    struct stat status{};
+    if (fstat(fd, &status) != 0 or static_cast<size_t>(status.st_size) < sizeof(SegmentHeader)) {
+      close(fd);
+      return std::nullopt;
+    }
+    Segment segment{fd, static_cast<size_t>(status.st_size)};
+    const auto *header = segment.header();
+    if (header->ready.load(std::memory_order_acquire) != 1 or header->magic != segment_magic or
+        header->version != segment_version or
+        segment_size(header->slot_count, header->ring_capacity) != segment.size) {
+      return std::nullopt;
+    }
+    return segment;
+  }
+
+  Segment(Segment &&other) noexcept
+          : fd(std::exchange(other.fd, -1)), size(other.size), memory(std::exchange(other.memory, nullptr)),
+            allocator(std::exchange(other.allocator, nullptr)) {}
+
+  Segment &operator=(Segment &&other) noexcept {
+    std::swap(fd, other.fd);
+    std::swap(size, other.size);
+    std::swap(memory, other.memory);
+    std::swap(allocator, other.allocator);
+    return *this;
+  }
+
+  ~Segment() {
+    if (memory != nullptr) {
+      munmap(memory, size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  SegmentHeader *header() const {
+    return static_cast<SegmentHeader *>(memory);
+  }
+
+  SlotHeader *slot_header(const uint32_t slot) const {
+    return reinterpret_cast<SlotHeader *>(static_cast<uint8_t *>(memory) + sizeof(SegmentHeader)) + slot;
+  }
+
+  uint8_t *ring_data(const uint32_t slot) const {
+    return static_cast<uint8_t *>(memory) + sizeof(SegmentHeader) + header()->slot_count * sizeof(SlotHeader) +
+           static_cast<size_t>(slot) * header()->ring_capacity;
+  }
+
+  template<typename Ring = SpscRing>
+  Ring ring(const uint32_t slot) const {
+    return Ring{&slot_header(slot)->control, ring_data(slot), header()->ring_capacity};
+  }
+
+  // Place memory of the ring on given NUMA node, if any - best-effort, see numa::bind_to_node() - and only then let
+  // allocator of the segment prefault and lock it, so that its pages are allocated on that node rather than on the node
+  // of the thread that created the segment. Producer side only
+  void prepare_ring(const uint32_t slot, const std::optional<int> node) const {
+    if (node and numa::bind_to_node(ring_data(slot), header()->ring_capacity, *node)) {
+      slot_header(slot)->numa_node.store(*node, std::memory_order_relaxed);
+    }
+    if (allocator != nullptr) {
+      allocator->populate(ring_data(slot), header()->ring_capacity);
+    }
+  }
+
+  // Identity of underlying shared memory object - lets agent notice that producer has recreated the segment
+  ino_t inode() const {
+    struct stat status{};
+    fstat(fd, &status);
+    return status.st_ino;
+  }
+
+private:
+  Segment(const int fd, const size_t size) : fd(fd), size(size) {
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+      const int error = errno;
+      memory = nullptr;
+      close(fd);
+      throw std::system_error(error, std::generic_category(), "mmap");
+    }
+  }
+
+  int fd;
+  size_t size;
+  void *memory{nullptr};
+  // Allocator the segment was created with, nullptr for segments opened by the agent
+  BufferAllocator *allocator{nullptr};
+};
+
+// Producer side of the transport. First shared_ring_count slots hold rings shared by all threads (the MPSC ring or
+// per-CPU rings, depending on producer mode), remaining slots are handed out to threads one per thread. Rings are
+// placed on the NUMA node of their CPU or of the thread that claimed them, so that logging never writes remote memory
+class ShmRingSource : public RingSource {
+public:
+  explicit ShmRingSource(Segment segment, const uint32_t shared_ring_count = 0)
+          : segment(std::move(segment)), shared_ring_count(shared_ring_count) {
+    rings = std::make_unique<ProducerRing[]>(this->segment.header()->slot_count);
+    for (uint32_t slot = 0; slot < shared_ring_count; ++slot) {
+      this->segment.prepare_ring(slot, producer_mode == ProducerMode::per_cpu_rings ? std::optional{numa::node_of_cpu(slot)}
+                                                                                    : std::nullopt);
+      this->segment.slot_header(slot)->state.store(SlotState::active, std::memory_order_release);
+      rings[slot] = this->segment.ring<ProducerRing>(slot);
+    }
+  }
+
+  ~ShmRingSource() override {
+    reset_ring_source(this);
+  }
+
+  ProducerRing *acquire_ring() override {
+    if (producer_mode == ProducerMode::shared_ring and shared_ring_count != 0) {
+      return &rings[0];
+    }
+    // Slots already bound to the node of the thread are preferred - their memory may have been touched, and pages
+    // mapped by the agent as well cannot be moved
+    const int node = numa::current_node();
+    for (const bool same_node_only: {true, false}) {
+      for (uint32_t slot = shared_ring_count; slot < segment.header()->slot_count; ++slot) {
+        auto *slot_header = segment.slot_header(slot);
+        if (same_node_only and slot_header->numa_node.load(std::memory_order_relaxed) != node) {
+          continue;
+        }
+        auto expected = SlotState::free;
+        if (slot_header->state.compare_exchange_strong(expected, SlotState::active, std::memory_order_acq_rel)) {
+          // Slot claimed again keeps its placement, populating its pages again is cheap
+          segment.prepare_ring(slot, slot_header->numa_node.load(std::memory_order_relaxed) != node ? std::optional{node}
+                                                                                                   : std::nullopt);
+          rings[slot] = segment.ring<ProducerRing>(slot);
+          return &rings[slot];
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  void release_ring(ProducerRing *ring) override {
+    const auto slot = static_cast<uint32_t>(ring - rings.get());
+    if (slot >= shared_ring_count) {
+      segment.slot_header(slot)->state.store(SlotState::retired, std::memory_order_release);
+    }
+  }
+
+  std::span<ProducerRing> get_cpu_rings() override {
+    if constexpr (producer_mode == ProducerMode::per_cpu_rings) {
+      return {rings.get(), shared_ring_count};
+    }
+    return {};
+  }
+
+  std::atomic<uint32_t> *get_consumer_sleeping() override {
+    return &segment.header()->consumer_sleeping;
+  }
+
+private:
+  Segment segment;
+  uint32_t shared_ring_count;
+  std::unique_ptr<ProducerRing[]> rings;
+};
+
+// Create segment with given name and direct tinylog records of all threads of this process to it. Returned source has
+// to outlive all threads that log. Ring capacity applies to every ring. Slot count is the number of per-thread rings:
+// with shared MPSC ring there are none, with per-CPU rings they are used only when rseq is not available. Memory of
+// rings that are never written is not touched, so it does not take physical memory. Latency-critical processes can pass
+// MappedBufferAllocator with prefault and lock enabled, so that logging never takes a page fault - rings are then
+// prefaulted when they are placed: shared rings when the source is created, thread rings when a thread claims them.
+// Allocator has to outlive the returned source
+[[nodiscard]] inline std::unique_ptr<ShmRingSource>
+attach(const std::string &name, const uint32_t slot_count = 64, const uint32_t ring_capacity = 1U << 20,
+       BufferAllocator &allocator = default_allocator()) {
+  uint32_t shared_ring_count{0};
+  uint32_t thread_slot_count{slot_count};
+  if constexpr (producer_mode == ProducerMode::shared_ring) {
+    shared_ring_count = 1;
+    thread_slot_count = 0;
+  } else if constexpr (producer_mode == ProducerMode::per_cpu_rings) {
+    shared_ring_count = detail::current_cpu() >= 0 ? static_cast<uint32_t>(sysconf(_SC_NPROCESSORS_CONF)) : 0;
+  }
+  const auto queue_kind = producer_mode == ProducerMode::per_thread_rings ? QueueKind::spsc : QueueKind::mpsc;
+  auto source = std::make_unique<ShmRingSource>(
+          Segment::create(name, shared_ring_count + thread_slot_count, ring_capacity, queue_kind, allocator),
+          shared_ring_count);
+  set_ring_source(source.get());
+  return source;
+}
+
+// Consumer side: pass all committed records of every slot to given function and free slots of exited threads. Returns
+// number of bytes drained. When node is given, only rings bound to that node are drained (rings not bound to any node
+// count as node 0)
+template<typename Function>
+size_t drain(const Segment &segment, Function &&function, const std::optional<int> node = std::nullopt) {
+  const auto drain_ring = [&function](auto ring) {
+    size_t drained{0};
+    for (auto readable = ring.readable(); not readable.empty(); readable = ring.readable()) {
+      protocol::for_each_record(readable, function);
+      ring.release(readable.size());
+      drained += readable.size();
+    }
+    return drained;
+  };
+
+  size_t drained{0};
+  for (uint32_t slot = 0; slot < segment.header()->slot_count; ++slot) {
+    auto &state = segment.slot_header(slot)->state;
+    const auto slot_state = state.load(std::memory_order_acquire);
+    if (slot_state == SlotState::free) {
+      continue;
+    }
+    if (node and std::max(segment.slot_header(slot)->numa_node.load(std::memory_order_relaxed), 0) != *node) {
+      continue;
+    }
+
+    drained += segment.header()->queue_kind == QueueKind::mpsc ? drain_ring(segment.ring<MpscRing>(slot))
+                                                               : drain_ring(segment.ring<SpscRing>(slot));
+
+    // State was read before draining, so everything that retired thread has written is already drained
+    if (slot_state == SlotState::retired) {
+      state.store(SlotState::free, std::memory_order_release);
+    }
+  }
+  return drained;
+}
+
+// Whether any slot holds records not drained yet
+inline bool has_records(const Segment &segment) {
+  for (uint32_t slot = 0; slot < segment.header()->slot_count; ++slot) {
+    if (segment.slot_header(slot)->state.load(std::memory_order_acquire) == SlotState::free) {
+      continue;
+    }
+    const bool empty = segment.header()->queue_kind == QueueKind::mpsc ? segment.ring<MpscRing>(slot).empty()
+                                                                       : segment.ring<SpscRing>(slot).empty();
+    if (not empty) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <file_index.hpp>
+#include <memory.hpp>
+#include <protocol.hpp>
+#include <statistics.hpp>
+
+namespace log4tiny {
+
+// Destination of drained record stream. Sink receives complete records only and is free to batch them until flush()
+class Sink {
+public:
+  virtual ~Sink() = default;
+
+  virtual void write(std::span<const uint8_t> records) = 0;
+
+  virtual void flush() = 0;
+
+  // Count batches written out and time spent writing them in given counters (nullptr stops counting). Batches are
+  // written out by write() as well, whenever it fills the batch, so timing flush() from outside would miss them
+  void set_write_counters(detail::BackendCounters *counters) {
+    write_counters = counters;
+  }
+
+protected:
+  // Run function writing out a batch, timed when counters are set
+  template<typename Function>
+  void count_write(Function &&function) {
+    if (write_counters == nullptr) {
+      function();
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    write_counters->count_sink_write(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+  }
+
+private:
+  detail::BackendCounters *write_counters{nullptr};
+};
+
+// Batching buffer shared by sinks - records are appended until the batch is full and the batch is handed over as a
+// whole, so that the number of system calls does not depend on the number of records. Memory comes from given
+// allocator, so that batches can be placed on huge pages, prefaulted and locked (see MappedBufferAllocator)
+class Batch {
+public:
+  explicit Batch(const size_t capacity, BufferAllocator &allocator = default_allocator())
+          : allocator(&allocator), buffer(static_cast<uint8_t *>(allocator.allocate(capacity))), limit(capacity) {}
+
+  Batch(Batch &&other) noexcept
+          : allocator(other.allocator), buffer(std::exchange(other.buffer, nullptr)),
+            length(std::exchange(other.length, 0)), limit(std::exchange(other.limit, 0)) {}
+
+  Batch &operator=(Batch &&other) noexcept {
+    std::swap(allocator, other.allocator);
+    std::swap(buffer, other.buffer);
+    std::swap(length, other.length);
+    std::swap(limit, other.limit);
+    return *this;
+  }
+
+  ~Batch() {
+    if (buffer != nullptr) {
+      allocator->deallocate(buffer, limit);
+    }
+  }
+
+  bool fits(const size_t size) const {
+    return length + size <= limit;
+  }
+
+  void append(std::span<const uint8_t> bytes) {
+    std::memcpy(buffer + length, bytes.data(), bytes.size());
+    length += bytes.size();
+  }
+
+  std::span<const uint8_t> bytes() const {
+    return {buffer, length};
+  }
+
+  void clear() {
+    length = 0;
+  }
+
+  bool empty() const {
+    return length == 0;
+  }
+
+  size_t capacity() const {
+    return limit;
+  }
+
+private:
+  BufferAllocator *allocator;
+  uint8_t *buffer;
+  size_t length{0};
+  size_t limit;
+};
+
+inline void write_all(const int fd, std::span<const uint8_t> bytes) {
+  while (not bytes.empty()) {
+    const auto written = ::write(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "write");
+    }
+    bytes = bytes.subspan(static_cast<size_t>(written));
+  }
+}
+
+inline std::span<const uint8_t> file_header_bytes() {
+  static constexpr protocol::FileHeader header{.magic = protocol::file_magic, .version = protocol::protocol_version};
+  return {reinterpret_cast<const uint8_t *>(&header), sizeof(header)};
+}
+
+// Binary log file. File starts with protocol::FileHeader followed by records. Unless disabled, sparse index of written
+// chunks is maintained in a sidecar file (see file_index.hpp) so that decoder can seek to a time range.
+class FileSink : public Sink {
+public:
+  explicit FileSink(const std::string &path, const size_t batch_size = 1U << 20, const bool write_index = true,
+                    BufferAllocator &allocator = default_allocator())
+          : batch(batch_size, allocator) {
+    fd = open_with_header(path);
+    if (write_index) {
+      index_fd = open_with_header(index_path(path));
+    }
+    offset = file_header_bytes().size();
+  }
+
+  FileSink(const FileSink &) = delete;
+
+  FileSink &operator=(const FileSink &) = delete;
+
+  ~FileSink() override {
+    try {
+      flush();
+    } catch (const std::exception &exception) {
+    }
+    ::close(fd);
+    if (index_fd >= 0) {
+      ::close(index_fd);
+    }
+  }
+
+  void write(std::span<const uint8_t> records) override {
+    if (not batch.fits(records.size())) {
+      flush();
+    }
+    if (index_fd >= 0) {
+      protocol::for_each_record(records, [this](std::span<const uint8_t> record) { index.add(record); });
+    }
+    if (records.size() > batch.capacity()) {
+      write_chunk(records);
+      return;
+    }
+    batch.append(records);
+  }
+
+  void flush() override {
+    if (not batch.empty()) {
+      write_chunk(batch.bytes());
+      batch.clear();
+    }
+  }
+
+private:
+  static int open_with_header(const std::string &path) {
+    const int file_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file_fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    write_all(file_fd, file_header_bytes());
+    return file_fd;
+  }
+
+  void write_chunk(std::span<const uint8_t> chunk) {
+    count_write([this, chunk] {
+      write_all(fd, chunk);
+      if (index_fd >= 0) {
+        write_all(index_fd, index.finish_chunk(offset, chunk.size()));
+      }
+    });
+    offset += chunk.size();
+  }
+
+  int fd;
+  int index_fd{-1};
+  uint64_t offset;
+  Batch batch;
+  ChunkIndexBuilder index{};
+};
+
+}
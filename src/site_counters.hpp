@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace log4tiny {
+
+// Volume logged by a call site, identified by CRC32 hash of its file path and line - stable across runs, unlike site ids
+struct SiteVolume {
+  uint32_t file_hash;
+  uint32_t line;
+  std::string file;
+  std::string format;
+  uint64_t records;
+  uint64_t bytes;
+  // Records of a sampled site stand for sampling_rate calls each (see tinylog_sampled)
+  uint32_t sampling_rate{1};
+};
+
+// Sort sites by bytes (then records) they produced, biggest first, and keep at most count of them
+inline std::vector<SiteVolume> top_talkers(std::vector<SiteVolume> volumes, const size_t count) {
+  std::ranges::sort(volumes, [](const SiteVolume &left, const SiteVolume &right) {
+    return left.bytes != right.bytes ? left.bytes > right.bytes : left.records > right.records;
+  });
+  volumes.resize(std::min(count, volumes.size()));
+  return volumes;
+}
+
+namespace detail {
+
+// Hit counter of a single call site, created on its first tinylog call when built with LOG4TINY_SITE_COUNTERS.
+// Counters of all sites form a lock-free list, so that registration does not need a lock and counters are never freed
+class SiteCounter {
+public:
+  SiteCounter(const uint32_t file_hash, const uint32_t line, const std::string_view file, const std::string_view format,
+              const uint32_t sampling_rate = 1)
+          : file_hash(file_hash), line(line), sampling_rate(sampling_rate), file(file), format(format) {
+    next = head().load(std::memory_order_relaxed);
+    while (not head().compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+  SiteCounter(const SiteCounter &) = delete;
+
+  SiteCounter &operator=(const SiteCounter &) = delete;
+
+  // Counters are shared by all threads calling the site, so a site called at high rate from many threads contends on
+  // them - which is why counters are opt-in
+  void count(const size_t bytes) {
+    records.fetch_add(1, std::memory_order_relaxed);
+    this->bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  static std::atomic<const SiteCounter *> &head() {
+    static std::atomic<const SiteCounter *> first{nullptr};
+    return first;
+  }
+
+  SiteVolume get_volume() const {
+    return {.file_hash = file_hash, .line = line, .file = std::string{file}, .format = std::string{format},
+            .records = records.load(std::memory_order_relaxed), .bytes = bytes.load(std::memory_order_relaxed),
+            .sampling_rate = sampling_rate};
+  }
+
+  const SiteCounter *get_next() const {
+    return next;
+  }
+
+private:
+  uint32_t file_hash;
+  uint32_t line;
+  uint32_t sampling_rate;
+  std::string_view file;
+  std::string_view format;
+  std::atomic<uint64_t> records{0};
+  std::atomic<uint64_t> bytes{0};
+  const SiteCounter *next{nullptr};
+};
+
+}
+
+// Volume of every call site called so far by this process. Bytes are sizes of encoded records, whether or not they
+// were written. Empty unless built with LOG4TINY_SITE_COUNTERS
+inline std::vector<SiteVolume> site_volumes() {
+  std::vector<SiteVolume> volumes{};
+  for (const auto *counter = detail::SiteCounter::head().load(std::memory_order_acquire); counter != nullptr;
+       counter = counter->get_next()) {
+    volumes.push_back(counter->get_volume());
+  }
+  return volumes;
+}
+
+}
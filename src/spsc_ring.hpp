@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <protocol.hpp>
+
+namespace log4tiny {
+
+inline constexpr size_t cache_line_size = 64;
+
+// Indices shared between producer and consumer. Indices grow monotonically and are masked with capacity when used,
+// so that full and empty ring can be distinguished without wasting space. Structure has to stay trivially placeable
+// in shared memory, hence no pointers are stored here. Each side keeps a copy of the other side's index on its own cache
+// line and reloads the shared one only when the copy says the ring is full (producer) or empty (consumer), so that in
+// steady state the sides do not touch each other's cache line on every record. Consumer's copy lives here, as consumer
+// ring objects are not kept between drains.
+struct RingControl {
+  alignas(cache_line_size) std::atomic<uint64_t> write_index{0};
+  alignas(cache_line_size) std::atomic<uint64_t> read_index{0};
+  std::atomic<uint64_t> cached_write_index{0};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring indices have to be lock-free to be placed in shared memory");
+
+// Single producer single consumer ring of variable-length records working on externally provided memory, so it can be
+// placed on the heap as well as in shared memory. Records are never split at the end of data area - when a record
+// does not fit, remaining space is filled with padding record and the record is placed at the beginning. Capacity has
+// to be a power of two and a multiple of protocol::record_alignment.
+// Producer may commit several records without publishing them (see commit()) and publish them all with a single store
+// of the write index.
+class SpscRing {
+public:
+  SpscRing() = default;
+
+  SpscRing(RingControl *control, uint8_t *data, const size_t capacity)
+          : control(control), data(data), capacity(capacity),
+            write_index(control->write_index.load(std::memory_order_relaxed)) {}
+
+  // Producer side: return pointer to contiguous space for record of given (aligned) length or nullptr when ring is
+  // full. Reserved space is published to consumer by commit()
+  uint8_t *reserve(const size_t length) {
+    const size_t offset = write_index & (capacity - 1);
+    const size_t space_till_end = capacity - offset;
+    const size_t padding = length <= space_till_end ? 0 : space_till_end;
+
+    if (write_index + padding + length - cached_read_index > capacity) {
+      cached_read_index = control->read_index.load(std::memory_order_acquire);
+      if (write_index + padding + length - cached_read_index > capacity) {
+        // Consumer cannot free any space while records of the batch are held back
+        publish();
+        return nullptr;
+      }
+    }
+
+    pending_padding = padding;
+    if (padding != 0) {
+      write_padding(data + offset, padding);
+      return data;
+    }
+    return data + offset;
+  }
+
+  // Finish reserved record. Unless told otherwise, the record is published to consumer immediately, otherwise it
+  // becomes visible with the next publish() or published commit
+  void commit(const size_t length, const bool publish_now = true) {
+    write_index += pending_padding + length;
+    if (publish_now) {
+      publish();
+    }
+  }
+
+  // Commit record written without its length (see protocol::write_record_header()), same as MpscRing::commit()
+  void commit(uint8_t *record, const size_t length, const bool publish_now = true) {
+    const auto record_length = static_cast<uint32_t>(length);
+    std::memcpy(record + offsetof(protocol::RecordHeader, length), &record_length, sizeof(record_length));
+    commit(length, publish_now);
+  }
+
+  // Bytes committed and not yet released, as far as the producer knows - read index is the one seen last
+  size_t get_occupancy() const {
+    return write_index - cached_read_index;
+  }
+
+  // Make all committed records visible to consumer
+  void publish() {
+    control->write_index.store(write_index, std::memory_order_release);
+  }
+
+  // Consumer side: return all committed bytes that are contiguous in memory. May contain padding records. Write index
+  // of the producer is read only when everything known to be committed has been consumed
+  std::span<const uint8_t> readable() const {
+    const uint64_t read_index = control->read_index.load(std::memory_order_relaxed);
+    uint64_t known_write_index = control->cached_write_index.load(std::memory_order_relaxed);
+    if (known_write_index <= read_index) {
+      known_write_index = control->write_index.load(std::memory_order_acquire);
+      control->cached_write_index.store(known_write_index, std::memory_order_relaxed);
+    }
+    const size_t offset = read_index & (capacity - 1);
+    return {data + offset, std::min<size_t>(known_write_index - read_index, capacity - offset)};
+  }
+
+  void release(const size_t length) {
+    const uint64_t read_index = control->read_index.load(std::memory_order_relaxed);
+    control->read_index.store(read_index + length, std::memory_order_release);
+  }
+
+  bool empty() const {
+    return control->read_index.load(std::memory_order_acquire) == control->write_index.load(std::memory_order_acquire);
+  }
+
+  size_t get_capacity() const {
+    return capacity;
+  }
+
+private:
+  // Only length and kind are written, as space left at the end may be shorter than the whole header
+  static void write_padding(uint8_t *destination, const size_t length) {
+    const auto padding_length = static_cast<uint32_t>(length);
+    const auto kind = protocol::RecordKind::padding;
+    std::memcpy(destination + offsetof(protocol::RecordHeader, length), &padding_length, sizeof(padding_length));
+    std::memcpy(destination + offsetof(protocol::RecordHeader, kind), &kind, sizeof(kind));
+  }
+
+  RingControl *control{nullptr};
+  uint8_t *data{nullptr};
+  size_t capacity{0};
+  uint64_t write_index{0};
+  uint64_t cached_read_index{0};
+  size_t pending_padding{0};
+};
+
+}
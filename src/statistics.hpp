@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace log4tiny {
+
+// Snapshot of self-instrumentation counters of the logging pipeline, meant for sizing rings and batches from production
+// data. Producer part sums counters of all threads that have logged, including exited ones. Backend part is filled in
+// by Backend::collect_statistics() and stays zero without an in-process backend.
+struct Statistics {
+  // Records (including site definitions) and their bytes committed to rings
+  uint64_t records_written{0};
+  uint64_t bytes_written{0};
+  // Records dropped because ring was full
+  uint64_t dropped_records{0};
+  // Highest ring occupancy in bytes seen by any producer when committing a record. Producers see the read index with
+  // delay, so this is an upper bound
+  uint64_t ring_high_water_mark{0};
+
+  uint64_t drained_records{0};
+  uint64_t drained_bytes{0};
+  // Drain passes that found records - drained_bytes / drain_batches is the mean batch size
+  uint64_t drain_batches{0};
+  uint64_t max_drain_batch_bytes{0};
+  // Time from record timestamp to the start of the drain pass that picked it up
+  uint64_t total_drain_latency_ns{0};
+  uint64_t max_drain_latency_ns{0};
+  // Batches written out by the sink - on flush or when a write filled the batch - and time spent writing them
+  uint64_t sink_writes{0};
+  uint64_t total_sink_write_ns{0};
+  uint64_t max_sink_write_ns{0};
+};
+
+namespace detail {
+
+// Counters are written by a single thread, so plain load and store is enough - no read-modify-write on the hot path.
+// Atomics only let other threads read them while collecting statistics
+inline void add(std::atomic<uint64_t> &counter, const uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void raise(std::atomic<uint64_t> &counter, const uint64_t value) {
+  if (value > counter.load(std::memory_order_relaxed)) {
+    counter.store(value, std::memory_order_relaxed);
+  }
+}
+
+struct ProducerCounters {
+  void count_record(const uint64_t length, const uint64_t ring_occupancy) {
+    add(records_written, 1);
+    add(bytes_written, length);
+    raise(ring_high_water_mark, ring_occupancy);
+  }
+
+  void count_drop() {
+    add(dropped_records, 1);
+  }
+
+  void add_to(Statistics &statistics) const {
+    statistics.records_written += records_written.load(std::memory_order_relaxed);
+    statistics.bytes_written += bytes_written.load(std::memory_order_relaxed);
+    statistics.dropped_records += dropped_records.load(std::memory_order_relaxed);
+    statistics.ring_high_water_mark = std::max(statistics.ring_high_water_mark,
+                                               ring_high_water_mark.load(std::memory_order_relaxed));
+  }
+
+  std::atomic<uint64_t> records_written{0};
+  std::atomic<uint64_t> bytes_written{0};
+  std::atomic<uint64_t> dropped_records{0};
+  std::atomic<uint64_t> ring_high_water_mark{0};
+};
+
+// Counters of live threads, and sum of counters of exited ones
+struct CounterRegistry {
+  std::mutex mutex{};
+  std::vector<const ProducerCounters *> live{};
+  Statistics retired{};
+};
+
+inline CounterRegistry &counter_registry() {
+  static CounterRegistry registry{};
+  return registry;
+}
+
+inline void register_counters(const ProducerCounters &counters) {
+  auto &registry = counter_registry();
+  const std::lock_guard lock{registry.mutex};
+  registry.live.push_back(&counters);
+}
+
+inline void unregister_counters(const ProducerCounters &counters) {
+  auto &registry = counter_registry();
+  const std::lock_guard lock{registry.mutex};
+  std::erase(registry.live, &counters);
+  counters.add_to(registry.retired);
+}
+
+struct BackendCounters {
+  // Drain pass picked up records with given count, bytes and sum and maximum of their latencies
+  void count_drain(const uint64_t records, const uint64_t bytes, const uint64_t latency_sum,
+                   const uint64_t max_latency) {
+    add(drained_records, records);
+    add(drained_bytes, bytes);
+    add(drain_batches, 1);
+    raise(max_drain_batch_bytes, bytes);
+    add(total_drain_latency_ns, latency_sum);
+    raise(max_drain_latency_ns, max_latency);
+  }
+
+  void count_sink_write(const uint64_t nanoseconds) {
+    add(sink_writes, 1);
+    add(total_sink_write_ns, nanoseconds);
+    raise(max_sink_write_ns, nanoseconds);
+  }
+
+  void add_to(Statistics &statistics) const {
+    statistics.drained_records += drained_records.load(std::memory_order_relaxed);
+    statistics.drained_bytes += drained_bytes.load(std::memory_order_relaxed);
+    statistics.drain_batches += drain_batches.load(std::memory_order_relaxed);
+    statistics.max_drain_batch_bytes = std::max(statistics.max_drain_batch_bytes,
+                                                max_drain_batch_bytes.load(std::memory_order_relaxed));
+    statistics.total_drain_latency_ns += total_drain_latency_ns.load(std::memory_order_relaxed);
+    statistics.max_drain_latency_ns = std::max(statistics.max_drain_latency_ns,
+                                               max_drain_latency_ns.load(std::memory_order_relaxed));
+    statistics.sink_writes += sink_writes.load(std::memory_order_relaxed);
+    statistics.total_sink_write_ns += total_sink_write_ns.load(std::memory_order_relaxed);
+    statistics.max_sink_write_ns = std::max(statistics.max_sink_write_ns,
+                                            max_sink_write_ns.load(std::memory_order_relaxed));
+  }
+
+  std::atomic<uint64_t> drained_records{0};
+  std::atomic<uint64_t> drained_bytes{0};
+  std::atomic<uint64_t> drain_batches{0};
+  std::atomic<uint64_t> max_drain_batch_bytes{0};
+  std::atomic<uint64_t> total_drain_latency_ns{0};
+  std::atomic<uint64_t> max_drain_latency_ns{0};
+  std::atomic<uint64_t> sink_writes{0};
+  std::atomic<uint64_t> total_sink_write_ns{0};
+  std::atomic<uint64_t> max_sink_write_ns{0};
+};
+
+}
+
+// Sum producer counters of all threads. Counters of running threads are read without stopping them, so snapshot is
+// not atomic across threads
+inline Statistics collect_statistics() {
+  auto &registry = detail::counter_registry();
+  const std::lock_guard lock{registry.mutex};
+  Statistics statistics = registry.retired;
+  for (const auto *counters: registry.live) {
+    counters->add_to(statistics);
+  }
+  return statistics;
+}
+
+}
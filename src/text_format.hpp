@@ -0,0 +1,448 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <format_parser.hpp>
+#include <protocol.hpp>
+
+namespace log4tiny::text {
+
+// printf-compatible rendering of single values without going through snprintf. Integers are converted with a table of
+// two-digit pairs, floating point values with std::to_chars (Ryu-based in libstdc++ and libc++, both for shortest and
+// precision-driven output). Flags, width and precision come from PlaceholderSpecification, with '*' values already
+// resolved by caller. Cases that are rare in logs and hard to get identical to printf ('#' with floating point and
+// %a) fall back to snprintf.
+
+struct ResolvedSpecification {
+  char flag{'\0'};
+  bool zero_padding{false};
+  unsigned width{0};
+  std::optional<unsigned> precision{};
+  char specifier{'\0'};
+  bool left_justify{false};
+
+  // Width and precision taken from arguments follow printf rules: negative width means left justification and
+  // negative precision is ignored
+  static constexpr ResolvedSpecification resolve(const PlaceholderSpecification &specification,
+                                                 const int64_t width_argument = 0, const int64_t precision_argument = 0) {
+    ResolvedSpecification resolved{.flag = specification.flag, .zero_padding = specification.zero_padding,
+            .width = specification.width.value_or(0), .precision = specification.precision,
+            .specifier = specification.specifier, .left_justify = specification.flag == '-'};
+    if (specification.width_from_argument) {
+      resolved.left_justify = resolved.left_justify or width_argument < 0;
+      resolved.width = static_cast<unsigned>(width_argument < 0 ? -width_argument : width_argument);
+    }
+    if (specification.precision_from_argument) {
+      resolved.precision = precision_argument < 0 ? std::nullopt
+                                                  : std::optional<unsigned>{static_cast<unsigned>(precision_argument)};
+    }
+    return resolved;
+  }
+};
+
+inline constexpr auto digit_pairs = [] {
+  std::array<char, 200> pairs{};
+  for (size_t value = 0; value < 100; ++value) {
+    pairs[2 * value] = static_cast<char>('0' + value / 10);
+    pairs[2 * value + 1] = static_cast<char>('0' + value % 10);
+  }
+  return pairs;
+}();
+
+// Write decimal digits of value ending just before end, return pointer to the first digit
+inline char *write_decimal_backwards(char *end, uint64_t value) {
+  while (value >= 100) {
+    const auto pair = static_cast<size_t>(value % 100) * 2;
+    value /= 100;
+    end -= 2;
+    std::memcpy(end, &digit_pairs[pair], 2);
+  }
+  if (value >= 10) {
+    end -= 2;
+    std::memcpy(end, &digit_pairs[static_cast<size_t>(value) * 2], 2);
+  } else {
+    *--end = static_cast<char>('0' + value);
+  }
+  return end;
+}
+
+inline char *write_hexadecimal_backwards(char *end, uint64_t value, const bool uppercase) {
+  const char *digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+  do {
+    *--end = digits[value & 0xF];
+    value >>= 4;
+  } while (value != 0);
+  return end;
+}
+
+inline char *write_octal_backwards(char *end, uint64_t value) {
+  do {
+    *--end = static_cast<char>('0' + (value & 0x7));
+    value >>= 3;
+  } while (value != 0);
+  return end;
+}
+
+// Append sign/prefix, zero padding and digits justified within the width
+inline void append_justified(std::string &output, const ResolvedSpecification &specification,
+                             const std::string_view prefix, const size_t zeros, const std::string_view digits) {
+  const size_t length = prefix.size() + zeros + digits.size();
+  const size_t padding = specification.width > length ? specification.width - length : 0;
+  if (not specification.left_justify) {
+    output.append(padding, ' ');
+  }
+  output.append(prefix);
+  output.append(zeros, '0');
+  output.append(digits);
+  if (specification.left_justify) {
+    output.append(padding, ' ');
+  }
+}
+
+inline std::string_view sign_prefix(const bool negative, const char flag) {
+  if (negative) {
+    return "-";
+  }
+  return flag == '+' ? "+" : flag == ' ' ? " " : "";
+}
+
+// Render %d, %i, %u, %o, %x, %X. Signed conversions pass magnitude and sign separately
+inline void append_integer(std::string &output, const ResolvedSpecification &specification, const uint64_t magnitude,
+                           const bool negative = false) {
+  std::array<char, 24> buffer;
+  char *const end = buffer.data() + buffer.size();
+  char *begin = end;
+  const bool is_signed = specification.specifier == 'd' or specification.specifier == 'i';
+  std::string_view prefix = is_signed ? sign_prefix(negative, specification.flag) : "";
+
+  if (not(specification.precision == 0U and magnitude == 0)) {
+    switch (specification.specifier) {
+      case 'x':
+      case 'X':
+        begin = write_hexadecimal_backwards(end, magnitude, specification.specifier == 'X');
+        if (specification.flag == '#' and magnitude != 0) {
+          prefix = specification.specifier == 'X' ? "0X" : "0x";
+        }
+        break;
+      case 'o':
+        begin = write_octal_backwards(end, magnitude);
+        break;
+      default:
+        begin = write_decimal_backwards(end, magnitude);
+        break;
+    }
+  }
+
+  const auto digit_count = static_cast<size_t>(end - begin);
+  size_t zeros = specification.precision.value_or(1) > digit_count ? specification.precision.value_or(1) - digit_count : 0;
+  if (specification.specifier == 'o' and specification.flag == '#' and zeros == 0 and (digit_count == 0 or *begin != '0')) {
+    zeros = 1;
+  }
+  // Zero flag pads up to the width, but only when precision is not given
+  if (specification.zero_padding and not specification.precision and not specification.left_justify) {
+    const size_t length = prefix.size() + zeros + digit_count;
+    zeros += specification.width > length ? specification.width - length : 0;
+  }
+  append_justified(output, specification, prefix, zeros, {begin, digit_count});
+}
+
+inline void append_signed_integer(std::string &output, const ResolvedSpecification &specification, const int64_t value) {
+  const bool negative = value < 0;
+  const uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  append_integer(output, specification, magnitude, negative);
+}
+
+// Render %f, %F, %e, %E, %g, %G (and %a, %A through snprintf)
+inline void append_floating(std::string &output, const ResolvedSpecification &specification, const double value) {
+  const char specifier = specification.specifier;
+  if (specifier == 'a' or specifier == 'A' or specification.flag == '#') {
+    std::string format{'%'};
+    if (specification.flag != '\0') {
+      format.push_back(specification.flag);
+    }
+    if (specification.left_justify and specification.flag != '-') {
+      format.push_back('-');
+    }
+    if (specification.zero_padding and specification.flag != '0') {
+      format.push_back('0');
+    }
+    format += std::to_string(specification.width);
+    if (specification.precision) {
+      format += "." + std::to_string(*specification.precision);
+    }
+    format.push_back(specifier);
+    const auto offset = output.size();
+    const auto length = static_cast<size_t>(std::snprintf(nullptr, 0, format.c_str(), value));
+    output.resize(offset + length + 1);
+    std::snprintf(output.data() + offset, length + 1, format.c_str(), value);
+    output.resize(offset + length);
+    return;
+  }
+
+  const bool uppercase = specifier == 'F' or specifier == 'E' or specifier == 'G';
+  const bool negative = std::signbit(value);
+  const auto prefix = sign_prefix(negative, specification.flag);
+  if (not std::isfinite(value)) {
+    const std::string_view text = std::isnan(value) ? (uppercase ? "NAN" : "nan") : (uppercase ? "INF" : "inf");
+    append_justified(output, specification, prefix, 0, text);
+    return;
+  }
+
+  const auto format = specifier == 'f' or specifier == 'F' ? std::chars_format::fixed
+                                                           : specifier == 'e' or specifier == 'E' ? std::chars_format::scientific
+                                                                                                  : std::chars_format::general;
+  const int precision = static_cast<int>(specification.precision.value_or(6));
+  // Typical values fit the stack buffer, large ones (largest double has 309 integral digits) or long precisions do not
+  std::array<char, 128> buffer;
+  std::string large_buffer;
+  auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), std::fabs(value), format, precision);
+  char *begin = buffer.data();
+  if (result.ec != std::errc{}) {
+    large_buffer.resize(330 + static_cast<size_t>(precision));
+    begin = large_buffer.data();
+    result = std::to_chars(begin, begin + large_buffer.size(), std::fabs(value), format, precision);
+  }
+  if (uppercase) {
+    std::replace(begin, result.ptr, 'e', 'E');
+  }
+  const std::string_view digits{begin, static_cast<size_t>(result.ptr - begin)};
+
+  size_t zeros{0};
+  if (specification.zero_padding and not specification.left_justify) {
+    const size_t length = prefix.size() + digits.size();
+    zeros = specification.width > length ? specification.width - length : 0;
+  }
+  append_justified(output, specification, prefix, zeros, digits);
+}
+
+inline void append_character(std::string &output, const ResolvedSpecification &specification, const char character) {
+  append_justified(output, specification, "", 0, {&character, 1});
+}
+
+inline void append_string(std::string &output, const ResolvedSpecification &specification, std::string_view string) {
+  if (specification.precision and *specification.precision < string.size()) {
+    string = string.substr(0, *specification.precision);
+  }
+  append_justified(output, specification, "", 0, string);
+}
+
+inline void append_pointer(std::string &output, const ResolvedSpecification &specification, const uint64_t address) {
+  if (address == 0) {
+    append_justified(output, specification, "", 0, "(nil)");
+    return;
+  }
+  std::array<char, 16> buffer;
+  char *const end = buffer.data() + buffer.size();
+  const char *begin = write_hexadecimal_backwards(end, address, false);
+  append_justified(output, specification, "0x", 0, {begin, static_cast<size_t>(end - begin)});
+}
+
+// Value as a signed integer, as it was logged
+inline int64_t as_signed(const protocol::ArgumentValue &value) {
+  switch (value.type) {
+    case protocol::ArgumentType::floating:
+      return static_cast<int64_t>(value.floating);
+    case protocol::ArgumentType::character:
+      return value.character;
+    case protocol::ArgumentType::string:
+    case protocol::ArgumentType::user:
+      return 0;
+    default:
+      return value.signed_int;
+  }
+}
+
+// Value converted like printf does for given length modifier: to int without a modifier ("%d" of 4294967295u is -1),
+// to signed char for hh ("%hhd" of 300 is 44) and to short for h. Other modifiers take 64 bits and keep the value
+inline int64_t as_signed(const protocol::ArgumentValue &value, const LengthModifier modifier) {
+  const auto result = as_signed(value);
+  switch (modifier) {
+    case LengthModifier::none:
+      return static_cast<int>(result);
+    case LengthModifier::hh:
+      return static_cast<signed char>(result);
+    case LengthModifier::h:
+      return static_cast<short>(result);
+    default:
+      return result;
+  }
+}
+
+// Value as an unsigned integer, as it was logged
+inline uint64_t as_unsigned(const protocol::ArgumentValue &value) {
+  switch (value.type) {
+    case protocol::ArgumentType::floating:
+      return static_cast<uint64_t>(as_signed(value));
+    case protocol::ArgumentType::character:
+      return static_cast<unsigned char>(value.character);
+    case protocol::ArgumentType::string:
+    case protocol::ArgumentType::user:
+      return 0;
+    default:
+      return value.unsigned_int;
+  }
+}
+
+// Unsigned counterpart of as_signed() with a length modifier ("%u" of -1 is 4294967295)
+inline uint64_t as_unsigned(const protocol::ArgumentValue &value, const LengthModifier modifier) {
+  const auto result = as_unsigned(value);
+  switch (modifier) {
+    case LengthModifier::none:
+      return static_cast<unsigned int>(result);
+    case LengthModifier::hh:
+      return static_cast<unsigned char>(result);
+    case LengthModifier::h:
+      return static_cast<unsigned short>(result);
+    default:
+      return result;
+  }
+}
+
+inline double as_double(const protocol::ArgumentValue &value) {
+  switch (value.type) {
+    case protocol::ArgumentType::floating:
+      return value.floating;
+    case protocol::ArgumentType::signed_int:
+    case protocol::ArgumentType::character:
+      return static_cast<double>(as_signed(value));
+    case protocol::ArgumentType::string:
+    case protocol::ArgumentType::user:
+      return 0.0;
+    default:
+      return static_cast<double>(value.unsigned_int);
+  }
+}
+
+// Text of a user type value, by its renderer or as its bytes in hex. Valid until the next call in the thread
+inline std::string_view render_user_value(const protocol::ArgumentValue &value) {
+  static thread_local std::string rendered{};
+  rendered.clear();
+  const std::span bytes{reinterpret_cast<const uint8_t *>(value.string.data()), value.string.size()};
+  if (value.renderer != nullptr) {
+    value.renderer(rendered, bytes);
+  } else {
+    append_codec_bytes(rendered, bytes);
+  }
+  return rendered;
+}
+
+// Render single placeholder with given arguments - values for '*' width/precision first. Values are converted to the
+// type expected by the specifier, so that mismatched argument does not lead to undefined behavior
+inline void render_placeholder(std::string &output, const PlaceholderSpecification &placeholder,
+                               std::span<const protocol::ArgumentValue> arguments) {
+  size_t next_argument{0};
+  const int64_t width = placeholder.width_from_argument ? as_signed(arguments[next_argument++]) : 0;
+  const int64_t precision = placeholder.precision_from_argument ? as_signed(arguments[next_argument++]) : 0;
+  const auto specification = ResolvedSpecification::resolve(placeholder, width, precision);
+  const auto &value = arguments[next_argument];
+
+  switch (placeholder.specifier) {
+    case 'd':
+    case 'i':
+      append_signed_integer(output, specification, as_signed(value, placeholder.length_modifier));
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      append_integer(output, specification, as_unsigned(value, placeholder.length_modifier));
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      append_floating(output, specification, as_double(value));
+      break;
+    case 'c':
+      append_character(output, specification, static_cast<char>(as_signed(value)));
+      break;
+    case 's':
+      if (value.type == protocol::ArgumentType::string) {
+        append_string(output, specification, value.string);
+      } else if (value.type == protocol::ArgumentType::user) {
+        append_string(output, specification, render_user_value(value));
+      } else {
+        append_string(output, specification, std::to_string(as_signed(value)));
+      }
+      break;
+    case 'p':
+      append_pointer(output, specification, value.unsigned_int);
+      break;
+    default:
+      // %n does not produce any output
+      break;
+  }
+}
+
+// Render fragments of given format - see split_format()
+inline void render_fragments(std::string &output, const std::string_view format,
+                             std::span<const FormatFragment> fragments,
+                             std::span<const protocol::ArgumentValue> arguments) {
+  for (const auto &fragment: fragments) {
+    output.append(format.data() + fragment.literal_offset, fragment.literal_length);
+    if (not fragment.placeholder) {
+      continue;
+    }
+    const auto count = fragment.placeholder->argument_count();
+    if (fragment.first_argument + count <= arguments.size()) {
+      render_placeholder(output, *fragment.placeholder, arguments.subspan(fragment.first_argument, count));
+    } else {
+      output += "<missing>";
+    }
+  }
+}
+
+// Append timestamp as UTC "YYYY-MM-DD HH:MM:SS.nnnnnnnnn". Date and time part is converted only when the second
+// changes - consecutive records of a thread mostly share it
+inline void format_timestamp(std::string &output, const uint64_t timestamp) {
+  static thread_local uint64_t cached_seconds{std::numeric_limits<uint64_t>::max()};
+  static thread_local std::array<char, 20> cached_prefix{};
+  const uint64_t seconds = timestamp / 1'000'000'000;
+  if (seconds != cached_seconds) {
+    const auto time_seconds = static_cast<time_t>(seconds);
+    std::tm time{};
+    gmtime_r(&time_seconds, &time);
+    const auto write_pair = [](char *destination, const int value) {
+      std::memcpy(destination, &digit_pairs[static_cast<size_t>(value) * 2], 2);
+    };
+    const int year = time.tm_year + 1900;
+    write_pair(cached_prefix.data(), year / 100 % 100);
+    write_pair(cached_prefix.data() + 2, year % 100);
+    cached_prefix[4] = '-';
+    write_pair(cached_prefix.data() + 5, time.tm_mon + 1);
+    cached_prefix[7] = '-';
+    write_pair(cached_prefix.data() + 8, time.tm_mday);
+    cached_prefix[10] = ' ';
+    write_pair(cached_prefix.data() + 11, time.tm_hour);
+    cached_prefix[13] = ':';
+    write_pair(cached_prefix.data() + 14, time.tm_min);
+    cached_prefix[16] = ':';
+    write_pair(cached_prefix.data() + 17, time.tm_sec);
+    cached_prefix[19] = '.';
+    cached_seconds = seconds;
+  }
+  std::array<char, 9> nanoseconds;
+  std::ranges::fill(nanoseconds, '0');
+  const auto fraction = timestamp % 1'000'000'000;
+  if (fraction != 0) {
+    write_decimal_backwards(nanoseconds.data() + nanoseconds.size(), fraction);
+  }
+  output.append(cached_prefix.data(), cached_prefix.size());
+  output.append(nanoseconds.data(), nanoseconds.size());
+}
+
+}
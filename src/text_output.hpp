@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <format_parser.hpp>
+#include <producer.hpp>
+#include <protocol.hpp>
+#include <text_format.hpp>
+
+namespace log4tiny {
+
+// Synchronous text mode for services that do not need the binary pipeline. When text output is set, log() renders the
+// line in the calling thread from format fragments split at compile time and hands it to the file descriptor with a
+// single write(). Lines look the same as in log4tiny_decoder output.
+
+namespace detail {
+
+inline std::atomic<int> text_output_fd{-1};
+
+inline std::string &text_line_buffer() {
+  static thread_local std::string line = [] {
+    std::string buffer{};
+    buffer.reserve(512);
+    return buffer;
+  }();
+  return line;
+}
+
+// Write the whole line, retrying on partial writes. Errors are not reported - logging must not fail the caller
+inline bool write_line(const int fd, std::string_view line) {
+  while (not line.empty()) {
+    const auto written = ::write(fd, line.data(), line.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    line.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+template<const std::string_view &format, const std::string_view &file, typename... T>
+void write_text_line(const int fd, const size_t line_number, const T &... args) {
+  auto &context = thread_context();
+  auto &line = text_line_buffer();
+  line.clear();
+  text::format_timestamp(line, timestamp_now());
+  line += " [";
+  text::append_integer(line, {.specifier = 'u'}, context.thread_id);
+  line += "] ";
+  line += file;
+  line.push_back(':');
+  text::append_integer(line, {.specifier = 'u'}, line_number);
+  line.push_back(' ');
+  const std::array<protocol::ArgumentValue, sizeof...(T)> arguments{protocol::make_argument_value(args)...};
+  text::render_fragments(line, format, format_fragments<format>, arguments);
+  line.push_back('\n');
+  if (write_line(fd, line)) {
+    context.counters.count_record(line.size(), 0);
+  } else {
+    context.counters.count_drop();
+  }
+}
+
+}
+
+// Render log records as text to given file descriptor (e.g. STDERR_FILENO) instead of encoding them into rings. Pass -1
+// to go back to binary records. Descriptor is not owned - it has to stay open as long as text output is set
+inline void set_text_output(const int fd) {
+  detail::text_output_fd.store(fd, std::memory_order_release);
+}
+
+}
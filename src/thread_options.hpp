@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+namespace log4tiny {
+
+enum class SchedulingPolicy {
+  inherit,
+  // Real-time policy - drain thread preempts regular threads of its CPUs. Needs CAP_SYS_NICE (or RLIMIT_RTPRIO), and
+  // as the thread spins while records are flowing, it should get CPUs of its own
+  fifo,
+  // Runs only when its CPUs have nothing else to do, so logging never delays application threads sharing them
+  idle
+};
+
+// Placement and identity of a drain thread (in-process backend or agent), so that draining stays off cores of
+// latency-critical threads
+struct ThreadOptions {
+  // CPUs the thread may run on, all CPUs when empty
+  std::vector<unsigned> cpus{};
+  SchedulingPolicy scheduling{SchedulingPolicy::inherit};
+  int fifo_priority{1};
+  // Shown by top, ps and perf. Names longer than 15 characters are truncated
+  std::string name{};
+};
+
+// Apply options to the calling thread. Every option is applied independently - returns false when any of them was
+// refused by the system (e.g. no privilege for SCHED_FIFO), in which case the thread keeps running as before
+inline bool configure_current_thread(const ThreadOptions &options) {
+  bool applied{true};
+  if (not options.cpus.empty()) {
+    cpu_set_t cpus{};
+    for (const auto cpu: options.cpus) {
+      CPU_SET(cpu, &cpus);
+    }
+    applied &= pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+  }
+  if (options.scheduling != SchedulingPolicy::inherit) {
+    const bool fifo = options.scheduling == SchedulingPolicy::fifo;
+    const sched_param parameters{.sched_priority = fifo ? options.fifo_priority : 0};
+    applied &= pthread_setschedparam(pthread_self(), fifo ? SCHED_FIFO : SCHED_IDLE, &parameters) == 0;
+  }
+  if (not options.name.empty()) {
+    applied &= pthread_setname_np(pthread_self(), options.name.substr(0, 15).c_str()) == 0;
+  }
+  return applied;
+}
+
+}
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <type_traits>
+#include <codec.hpp>
 
 namespace log4tiny::matcher {
 
@@ -72,6 +74,12 @@ struct StringType {
   constexpr bool matches(const char *&&t) const {
     return true;
   }
+
+  // User types with a codec are rendered as text
+  template<typename T> requires CodecArgument<std::remove_cvref_t<T>>
+  constexpr bool matches(T &&) const {
+    return true;
+  }
 };
 
 struct PointerType {
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <linux/errqueue.h>
+#include <sink.hpp>
+
+namespace log4tiny {
+
+enum class SocketType : int {
+  stream = SOCK_STREAM,
+  seqpacket = SOCK_SEQPACKET
+};
+
+// Stream records to a local collector over Unix domain socket, avoiding filesystem round trip. Every connection starts
+// with protocol::FileHeader followed by records. Records are sent in large batches - with SOCK_SEQPACKET every batch
+// is a single message holding complete records only, so batch size has to stay below socket send buffer size.
+// Batches are double buffered. Where the socket supports SO_ZEROCOPY, batches are sent with MSG_ZEROCOPY and a buffer
+// is refilled only after the kernel reports completion of its last send. When collector is not reachable, batches are
+// dropped and connecting is retried on the next flush.
+class UnixSocketSink : public Sink {
+public:
+  explicit UnixSocketSink(std::string path, const SocketType type = SocketType::stream,
+                          const size_t batch_size = 128U << 10, BufferAllocator &allocator = default_allocator())
+          : path(std::move(path)), type(type), batches{Batch{batch_size, allocator}, Batch{batch_size, allocator}} {}
+
+  UnixSocketSink(const UnixSocketSink &) = delete;
+
+  UnixSocketSink &operator=(const UnixSocketSink &) = delete;
+
+  ~UnixSocketSink() override {
+    flush();
+    disconnect();
+  }
+
+  void write(std::span<const uint8_t> records) override {
+    if (not current().fits(records.size())) {
+      flush();
+    }
+    // Records larger than the whole batch cannot be sent as a single packet and are dropped
+    if (records.size() > current().capacity()) {
+      dropped_bytes += records.size();
+      return;
+    }
+    current().append(records);
+  }
+
+  void flush() override {
+    if (current().empty()) {
+      return;
+    }
+    if (fd < 0 and not connect()) {
+      dropped_bytes += current().bytes().size();
+      current().clear();
+      return;
+    }
+    count_write([this] {
+      if (send_batch(current().bytes())) {
+        if (zerocopy) {
+          last_send_id[current_batch] = next_send_id - 1;
+        }
+      } else {
+        dropped_bytes += current().bytes().size();
+        disconnect();
+      }
+      current_batch ^= 1U;
+      wait_for_completion(current_batch);
+    });
+    current().clear();
+  }
+
+  bool is_zerocopy_enabled() const {
+    return zerocopy;
+  }
+
+  uint64_t get_dropped_bytes() const {
+    return dropped_bytes;
+  }
+
+private:
+  Batch &current() {
+    return batches[current_batch];
+  }
+
+  bool connect() {
+    fd = ::socket(AF_UNIX, static_cast<int>(type) | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return false;
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+      disconnect();
+      return false;
+    }
+
+    const int send_buffer_size = static_cast<int>(2 * current().capacity());
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(send_buffer_size));
+#ifdef SO_ZEROCOPY
+    const int enable = 1;
+    zerocopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0;
+#endif
+    next_send_id = 0;
+    completed_send_id = std::nullopt;
+    last_send_id = {};
+
+    // Header is static, so it can be sent with MSG_ZEROCOPY without waiting for completion
+    if (not send_batch(file_header_bytes())) {
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  void disconnect() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+    zerocopy = false;
+  }
+
+  bool send_batch(std::span<const uint8_t> bytes) {
+    const int flags = MSG_NOSIGNAL | zerocopy_flag();
+    while (not bytes.empty()) {
+      const auto sent = ::send(fd, bytes.data(), bytes.size(), flags);
+      if (sent < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      if (zerocopy) {
+        ++next_send_id;
+      }
+      bytes = bytes.subspan(static_cast<size_t>(sent));
+    }
+    return true;
+  }
+
+  int zerocopy_flag() const {
+#ifdef MSG_ZEROCOPY
+    return zerocopy ? MSG_ZEROCOPY : 0;
+#else
+    return 0;
+#endif
+  }
+
+  // Block until kernel no longer references memory of given batch
+  void wait_for_completion(const unsigned batch) {
+    if (not zerocopy or not last_send_id[batch]) {
+      return;
+    }
+    while (fd >= 0 and (not completed_send_id or *completed_send_id < *last_send_id[batch])) {
+      pollfd descriptor{.fd = fd, .events = 0, .revents = 0};
+      if (::poll(&descriptor, 1, -1) < 0 and errno != EINTR) {
+        disconnect();
+        break;
+      }
+      read_completions();
+    }
+    last_send_id[batch] = std::nullopt;
+  }
+
+  void read_completions() {
+    std::array<char, 128> control{};
+    msghdr message{};
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    while (::recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0) {
+      for (auto *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+        const auto *error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(header));
+        if (error->ee_errno == 0 and error->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+          completed_send_id = error->ee_data;
+        }
+      }
+      message.msg_controllen = control.size();
+    }
+  }
+
+  std::string path;
+  SocketType type;
+  int fd{-1};
+  bool zerocopy{false};
+  std::array<Batch, 2> batches;
+  unsigned current_batch{0};
+  uint32_t next_send_id{0};
+  std::optional<uint32_t> completed_send_id{};
+  std::array<std::optional<uint32_t>, 2> last_send_id{};
+  uint64_t dropped_bytes{0};
+};
+
+}
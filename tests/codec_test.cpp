@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <decoder.hpp>
+#include <format_parser.hpp>
+#include <json_output.hpp>
+#include "test_records.hpp"
+
+using namespace log4tiny;
+using namespace log4tiny::test;
+
+namespace {
+
+struct Price {
+  int64_t units;
+  int32_t cents;
+};
+
+struct Opaque {
+  uint16_t value;
+};
+
+}
+
+template<>
+struct log4tiny::codec<Price> {
+  static constexpr std::string_view name = "Price";
+
+  static void render(std::string &output, const Price &price) {
+    output += std::to_string(price.units) + "." + (price.cents < 10 ? "0" : "") + std::to_string(price.cents);
+  }
+};
+
+template<>
+struct log4tiny::codec<Opaque> {
+  static constexpr std::string_view name = "Opaque";
+};
+
+TEST(Codec, UserTypeMatchesStringPlaceholder) {
+  const auto result = parse_format_to_placeholder_matchers("%s");
+  ASSERT_EQ(result.size(), 1);
+  EXPECT_TRUE(result.at(0).matches<Price>());
+  EXPECT_FALSE(matcher::PlaceholderType{matcher::SignedIntType{}}.matches<Price>());
+}
+
+TEST(Codec, EncodeValueBytes) {
+  static_assert(protocol::argument_type_of<Price>() == protocol::ArgumentType::user);
+  EXPECT_EQ(protocol::encoded_size(Price{.units = 1, .cents = 2}), sizeof(Price));
+  EXPECT_EQ(protocol::encoded_size(Opaque{.value = 1}), sizeof(Opaque));
+}
+
+TEST(Codec, ParseSiteRecordWithUserTypes) {
+  register_codec<Price>();
+  const auto site = decoder::parse_site_record(make_site_record<int, Price, Opaque>(0, "%d %s %s"));
+  ASSERT_TRUE(site);
+  EXPECT_EQ(site->format, "%d %s %s");
+  EXPECT_EQ(site->argument_types, (std::vector{protocol::ArgumentType::signed_int, protocol::ArgumentType::user,
+                                               protocol::ArgumentType::user}));
+  ASSERT_EQ(site->codecs.size(), 2);
+  EXPECT_EQ(site->codecs[0].name, "Price");
+  EXPECT_EQ(site->codecs[0].size, sizeof(Price));
+  EXPECT_NE(site->codecs[0].renderer, nullptr);
+  EXPECT_EQ(site->codecs[1].name, "Opaque");
+  EXPECT_EQ(site->codecs[1].renderer, nullptr);
+}
+
+TEST(Codec, RenderRegisteredTypeInDecoder) {
+  register_codec<Price>();
+  EXPECT_EQ(render("price %s of %d items", Price{.units = 12, .cents = 5}, 3), "price 12.05 of 3 items");
+  EXPECT_EQ(render("[%8s]", Price{.units = 1, .cents = 50}), "[    1.50]");
+}
+
+TEST(Codec, RenderTypeWithoutRendererAsBytes) {
+  EXPECT_EQ(render("value %s", Opaque{.value = 0x1234}), "value <3412>");
+}
+
+TEST(Codec, RenderInProducer) {
+  // Value refers to bytes of the argument, which has to outlive it
+  const Price price{.units = 7, .cents = 25};
+  const std::vector arguments{protocol::make_argument_value(price)};
+  std::string output{};
+  text::render_placeholder(output, *parse_placeholder_specification("%s"), arguments);
+  EXPECT_EQ(output, "7.25");
+}
+
+TEST(Codec, TruncatedRecordIsRejected) {
+  const auto site = decoder::parse_site_record(make_site_record<Price>(0, "%s"));
+  auto record = make_log_record(0, 0, Price{.units = 1, .cents = 2});
+  record.resize(sizeof(protocol::RecordHeader) + sizeof(Price) - 1);
+  EXPECT_FALSE(decoder::decode_arguments(*site, record));
+}
+
+TEST(Codec, JsonArgumentIsRenderedText) {
+  register_codec<Price>();
+  const auto site = decoder::parse_site_record(make_site_record<Price>(0, "%{price}s"));
+  const auto arguments = decoder::decode_arguments(*site, make_log_record(0, 0, Price{.units = 3, .cents = 99}));
+  std::string output{};
+  json::append_argument(output, arguments->at(0));
+  EXPECT_EQ(output, "\"3.99\"");
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <column_export.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+decoder::SiteInfo make_site(const uint32_t line, const std::string_view format,
+                            std::vector<protocol::ArgumentType> argument_types) {
+  return {.file_hash = 0xABCD, .line = line, .file = "file.cpp", .format = std::string{format},
+          .argument_types = std::move(argument_types), .program = decoder::RenderProgram::compile(format),
+          .sampling_rate = 1, .level = protocol::Level::info};
+}
+
+protocol::RecordHeader make_header(const uint32_t site_id, const uint64_t timestamp) {
+  return {.length = 0, .kind = protocol::RecordKind::log, .reserved = 0, .site_id = site_id, .thread_id = 5,
+          .timestamp = timestamp};
+}
+
+std::string read_file(const std::filesystem::path &path) {
+  std::ifstream file{path, std::ios::binary};
+  return std::string{std::istreambuf_iterator<char>{file}, {}};
+}
+
+// Values of a fixed-width column, checking its header
+template<typename T>
+std::vector<T> read_column(const std::filesystem::path &path, const columns::ColumnType type) {
+  const auto bytes = read_file(path);
+  columns::ColumnHeader header{};
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  EXPECT_EQ(header.magic, columns::column_magic);
+  EXPECT_EQ(header.type, type);
+  EXPECT_EQ(bytes.size(), sizeof(header) + header.row_count * sizeof(T));
+  std::vector<T> values(header.row_count);
+  std::memcpy(values.data(), bytes.data() + sizeof(header), values.size() * sizeof(T));
+  return values;
+}
+
+}
+
+TEST(ColumnExport, ColumnPerPlaceholderOfEverySite) {
+  const auto directory = std::filesystem::temp_directory_path() / ("log4tiny_columns_" + std::to_string(getpid()));
+  const auto orders = make_site(10, "order %{order_id}u at %.2f by %{trader}s",
+                                {protocol::ArgumentType::unsigned_int, protocol::ArgumentType::floating,
+                                 protocol::ArgumentType::string});
+  const auto padded = make_site(20, "%{timestamp}*d", {protocol::ArgumentType::unsigned_int,
+                                                       protocol::ArgumentType::signed_int});
+  {
+    columns::ColumnExporter exporter{directory};
+    exporter.add(make_header(0, 100), orders, std::vector{protocol::make_argument_value(1U),
+            protocol::make_argument_value(9.5), protocol::make_argument_value("ann")});
+    exporter.add(make_header(1, 150), padded, std::vector{protocol::make_argument_value(4U),
+            protocol::make_argument_value(-3)});
+    exporter.add(make_header(0, 200), orders, std::vector{protocol::make_argument_value(2U),
+            protocol::make_argument_value(0.25), protocol::make_argument_value("bob\nby")});
+    // The same site logged by another run of the producer under a different id
+    exporter.forget_site(0);
+    exporter.add(make_header(7, 300), orders, std::vector{protocol::make_argument_value(3U),
+            protocol::make_argument_value(1.0), protocol::make_argument_value("")});
+    exporter.finish();
+  }
+
+  const auto orders_directory = directory / "site_0000abcd_10";
+  EXPECT_EQ(read_file(orders_directory / "schema.txt"),
+            "file file.cpp\nline 10\nformat order %{order_id}u at %.2f by %{trader}s\nrows 3\n"
+            "column timestamp uint64\ncolumn thread uint32\ncolumn order_id uint64\ncolumn arg1 float64\n"
+            "column trader string\n");
+  EXPECT_EQ(read_column<uint64_t>(orders_directory / "timestamp.col", columns::ColumnType::uint64),
+            (std::vector<uint64_t>{100, 200, 300}));
+  EXPECT_EQ(read_column<uint32_t>(orders_directory / "thread.col", columns::ColumnType::uint32),
+            (std::vector<uint32_t>{5, 5, 5}));
+  EXPECT_EQ(read_column<uint64_t>(orders_directory / "order_id.col", columns::ColumnType::uint64),
+            (std::vector<uint64_t>{1, 2, 3}));
+  EXPECT_EQ(read_column<double>(orders_directory / "arg1.col", columns::ColumnType::float64),
+            (std::vector<double>{9.5, 0.25, 1.0}));
+  EXPECT_EQ(read_column<uint64_t>(orders_directory / "trader.col", columns::ColumnType::string),
+            (std::vector<uint64_t>{3, 9, 9}));
+  EXPECT_EQ(read_file(orders_directory / "trader.str"), "annbob\nby");
+
+  // Width argument is not a column of its own, placeholder named like a record column gets a distinct name
+  const auto padded_directory = directory / "site_0000abcd_20";
+  EXPECT_EQ(read_column<int64_t>(padded_directory / "timestamp_.col", columns::ColumnType::int64),
+            (std::vector<int64_t>{-3}));
+  EXPECT_FALSE(std::filesystem::exists(padded_directory / "arg0.col"));
+
+  std::filesystem::remove_all(directory);
+}
+
+// Sites with more columns than open files allowed - files are closed and reopened for appending as records interleave
+TEST(ColumnExport, MoreColumnsThanOpenFiles) {
+  const auto directory = std::filesystem::temp_directory_path() / ("log4tiny_columns_lru_" + std::to_string(getpid()));
+  constexpr uint32_t site_count = 20;
+  std::vector<decoder::SiteInfo> sites{};
+  for (uint32_t line = 0; line < site_count; ++line) {
+    sites.push_back(make_site(line, "%{value}d by %{name}s", {protocol::ArgumentType::signed_int,
+                                                             protocol::ArgumentType::string}));
+  }
+  const auto open_descriptors = [] {
+    const std::filesystem::directory_iterator descriptors{"/proc/self/fd"};
+    return std::distance(begin(descriptors), end(descriptors));
+  };
+  const auto descriptors_before = open_descriptors();
+  {
+    columns::ColumnExporter exporter{directory, 8};
+    for (int round = 0; round < 3; ++round) {
+      for (uint32_t site = 0; site < site_count; ++site) {
+        const auto name = std::to_string(site);
+        exporter.add(make_header(site, round), sites[site], std::vector{
+                protocol::make_argument_value(static_cast<int>(site) * 10 + round),
+                protocol::make_argument_value(name.c_str())});
+      }
+    }
+    EXPECT_LE(open_descriptors() - descriptors_before, 8);
+    exporter.finish();
+  }
+
+  for (uint32_t site = 0; site < site_count; ++site) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "site_0000abcd_%u", site);
+    const auto site_directory = directory / name;
+    const auto value = static_cast<int64_t>(site) * 10;
+    EXPECT_EQ(read_column<uint64_t>(site_directory / "timestamp.col", columns::ColumnType::uint64),
+              (std::vector<uint64_t>{0, 1, 2}));
+    EXPECT_EQ(read_column<int64_t>(site_directory / "value.col", columns::ColumnType::int64),
+              (std::vector<int64_t>{value, value + 1, value + 2}));
+    const auto length = std::to_string(site).size();
+    EXPECT_EQ(read_column<uint64_t>(site_directory / "name.col", columns::ColumnType::string),
+              (std::vector<uint64_t>{length, 2 * length, 3 * length}));
+    EXPECT_EQ(read_file(site_directory / "name.str"), std::to_string(site) + std::to_string(site) + std::to_string(site));
+    EXPECT_NE(read_file(site_directory / "schema.txt").find("rows 3\n"), std::string::npos);
+  }
+
+  std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <decoder.hpp>
+#include <sink.hpp>
+#include "test_records.hpp"
+
+using namespace log4tiny;
+using namespace log4tiny::test;
+
+TEST(Decoder, ParseSiteRecord) {
+  const auto site = decoder::parse_site_record(make_site_record<int, const char *>(3, "value %d of %s"));
+  ASSERT_TRUE(site);
+  EXPECT_EQ(site->file_hash, 0xABCD);
+  EXPECT_EQ(site->line, 42);
+  EXPECT_EQ(site->file, "file.cpp");
+  EXPECT_EQ(site->format, "value %d of %s");
+  EXPECT_EQ(site->level, protocol::Level::info);
+  EXPECT_EQ(site->argument_types,
+            (std::vector{protocol::ArgumentType::signed_int, protocol::ArgumentType::string}));
+}
+
+TEST(Decoder, RenderMessageLikePrintf) {
+  EXPECT_EQ(render("no placeholders"), "no placeholders");
+  EXPECT_EQ(render("100%% sure"), "100% sure");
+  EXPECT_EQ(render("%d %u %x %o", -5, 7U, 255U, 8U), "-5 7 ff 10");
+  EXPECT_EQ(render("%+05d|%-4u|", 42, 3U), "+0042|3   |");
+  EXPECT_EQ(render("%.3f %e", 3.14159, 1000.0), "3.142 1.000000e+03");
+  EXPECT_EQ(render("%c%c %s", 'o', 'k', std::string{"text"}), "ok text");
+  EXPECT_EQ(render("%.2s", "abcdef"), "ab");
+  EXPECT_EQ(render("%*d|%.*f", 4U, 7, 1U, 2.25), "   7|2.2");
+  EXPECT_EQ(render("%lld %hhu %Lf", 1LL, static_cast<unsigned char>(200), 0.5), "1 200 0.500000");
+}
+
+TEST(Decoder, CompileRenderProgram) {
+  const auto program = decoder::RenderProgram::compile("a=%-*d%% b=%s.");
+  const auto &fragments = program.get_fragments();
+  ASSERT_EQ(fragments.size(), 4);
+  EXPECT_EQ(fragments[0].literal_length, 2);
+  EXPECT_EQ(fragments[0].placeholder->specifier, 'd');
+  EXPECT_EQ(fragments[1].literal_length, 1);
+  EXPECT_FALSE(fragments[1].placeholder);
+  EXPECT_EQ(fragments[2].literal_length, 3);
+  EXPECT_EQ(fragments[2].first_argument, 2);
+  EXPECT_EQ(fragments[2].placeholder->specifier, 's');
+  EXPECT_EQ(fragments[3].literal_length, 1);
+  EXPECT_FALSE(fragments[3].placeholder);
+  EXPECT_EQ(program.get_argument_count(), 3);
+  EXPECT_TRUE(decoder::RenderProgram::compile("").get_fragments().empty());
+}
+
+TEST(Decoder, RenderNamedPlaceholdersAsFields) {
+  EXPECT_EQ(render("order %{order_id}u at %{price}.2f", 42U, 9.5), "order 42 at 9.50");
+
+  const auto site = decoder::parse_site_record(
+          make_site_record<unsigned, unsigned, int, std::string>(0, "order %{order_id}u %*d %{note}s"));
+  EXPECT_EQ(site->program.get_field_names(), (std::vector<std::string>{"order_id", "arg2", "note"}));
+  const auto arguments = decoder::decode_arguments(*site, make_log_record(0, 0, 42U, 4U, 7, std::string{"say \"hi\""}));
+  std::string fields{};
+  site->program.render_fields(fields, *arguments);
+  EXPECT_EQ(fields, R"(order_id=42 arg2="   7" note="say \"hi\"")");
+}
+
+TEST(Decoder, MismatchedArgumentsAreConverted) {
+  EXPECT_EQ(render("%f", 3), "3.000000");
+  EXPECT_EQ(render("%d", 2.75), "2");
+  EXPECT_EQ(render("%s", 12), "12");
+  EXPECT_EQ(render("%d %d", 1), "1 <missing>");
+}
+
+TEST(Decoder, CorruptedRecordIsRejected) {
+  const auto site = decoder::parse_site_record(make_site_record<std::string>(0, "%s"));
+  auto record = make_log_record(0, 0, std::string{"text"});
+  const uint32_t corrupted_length = 1000;
+  std::memcpy(record.data() + sizeof(protocol::RecordHeader), &corrupted_length, sizeof(corrupted_length));
+  EXPECT_FALSE(decoder::decode_arguments(*site, record));
+}
+
+TEST(Decoder, TimestampParsingAndFormatting) {
+  EXPECT_EQ(decoder::parse_timestamp("1700000000123456789"), 1700000000123456789ULL);
+  EXPECT_EQ(decoder::parse_timestamp("2023-11-14T22:13:20.5"), 1700000000500000000ULL);
+  EXPECT_EQ(decoder::parse_timestamp("2023-11-14 22:13:20"), 1700000000000000000ULL);
+  EXPECT_FALSE(decoder::parse_timestamp("yesterday"));
+
+  std::string output{};
+  decoder::format_timestamp(output, 1700000000000000042ULL);
+  EXPECT_EQ(output, "2023-11-14 22:13:20.000000042");
+  output.clear();
+  decoder::format_timestamp(output, 1700000001999999999ULL);
+  EXPECT_EQ(output, "2023-11-14 22:13:21.999999999");
+  output.clear();
+  decoder::format_timestamp(output, 0);
+  EXPECT_EQ(output, "1970-01-01 00:00:00.000000000");
+}
+
+TEST(Decoder, IndexSelectsOnlyChunksOfRequestedTimeRange) {
+  const std::string path = testing::TempDir() + "log4tiny_index_test.bin";
+  {
+    // Every batch holds two records, so every chunk covers two consecutive timestamps
+    const auto site_record = make_site_record<int>(0, "%d");
+    const auto record_length = make_log_record(0, 0, 0).size();
+    FileSink sink{path, 2 * record_length};
+    sink.write(site_record);
+    for (int i = 0; i < 100; ++i) {
+      sink.write(make_log_record(0, 1000 + static_cast<uint64_t>(i), i));
+    }
+  }
+
+  const decoder::LogFile file{path};
+  const auto index = file.load_index();
+  ASSERT_TRUE(index);
+  EXPECT_EQ(index->get_chunks().size(), 51);
+  EXPECT_EQ(index->indexed_end(), file.size());
+
+  const auto [first, last] = index->find_chunks(1050, 1059);
+  EXPECT_EQ(first, 26);
+  EXPECT_EQ(last, 31);
+
+  // Site definition written in the first chunk is available in the sidecar
+  decoder::SiteRegistry sites{};
+  protocol::for_each_record(index->get_records(), [&](std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (header.kind == protocol::RecordKind::site) {
+      sites.define(record);
+    }
+  });
+  ASSERT_NE(sites.find(0), nullptr);
+
+  std::vector<int> values{};
+  for (size_t chunk = first; chunk < last; ++chunk) {
+    const auto &entry = index->get_chunks().at(chunk).entry;
+    file.read_records(entry.offset, entry.offset + entry.length, [&](std::span<const uint8_t> record) {
+      values.push_back(static_cast<int>(decoder::decode_arguments(*sites.find(0), record)->at(0).signed_int));
+    });
+  }
+  EXPECT_EQ(values, (std::vector{50, 51, 52, 53, 54, 55, 56, 57, 58, 59}));
+}
+
+TEST(Decoder, ReadWholeLogWithoutIndex) {
+  const std::string path = testing::TempDir() + "log4tiny_no_index_test.bin";
+  {
+    FileSink sink{path, 64, false};
+    sink.write(make_site_record<int>(0, "%d"));
+    for (int i = 0; i < 10; ++i) {
+      sink.write(make_log_record(0, 0, i));
+    }
+  }
+  const decoder::LogFile file{path};
+  EXPECT_FALSE(file.load_index());
+  size_t records{0};
+  file.read_records(sizeof(protocol::FileHeader), file.size(), [&](std::span<const uint8_t>) { ++records; });
+  EXPECT_EQ(records, 11);
+}
+
+TEST(Decoder, VolumeOfSiteIsSummedOverRuns) {
+  decoder::SiteRegistry sites{};
+  decoder::VolumeCounter volumes{};
+  // Site of a second run of the producer gets another id, but it is the same file and line
+  sites.define(make_site_record<int>(0, "%d"));
+  sites.define(make_site_record<int>(1, "%d"));
+  for (int i = 0; i < 3; ++i) {
+    volumes.add(*sites.find(i % 2), make_log_record(static_cast<uint32_t>(i % 2), 0, i).size());
+  }
+
+  const auto all = volumes.get_volumes();
+  ASSERT_EQ(all.size(), 1);
+  EXPECT_EQ(all.at(0).line, 42);
+  EXPECT_EQ(all.at(0).format, "%d");
+  EXPECT_EQ(all.at(0).records, 3);
+  EXPECT_EQ(all.at(0).bytes, 3 * make_log_record(0, 0, 0).size());
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <limits>
+#include <vector>
+#include <float_codec.hpp>
+
+using namespace log4tiny::compression;
+
+// Encode all values as a single stream and return number of bits used while verifying that decoded values are
+// bit-identical with the original ones
+size_t encode_and_verify_roundtrip(const std::vector<double> &values) {
+  std::vector<uint8_t> storage(values.size() * XorFloatEncoder::max_encoded_bytes, 0);
+  BitWriter writer{storage};
+  XorFloatEncoder encoder{};
+  for (const auto value: values) {
+    encoder.encode(value, writer);
+  }
+  writer.flush();
+
+  BitReader reader{storage};
+  XorFloatDecoder decoder{};
+  for (const auto value: values) {
+    EXPECT_EQ(std::bit_cast<uint64_t>(decoder.decode(reader)), std::bit_cast<uint64_t>(value));
+  }
+  EXPECT_EQ(reader.bits_read(), writer.bits_written());
+  return writer.bits_written();
+}
+
+TEST(BitStream, WriteAndReadBack) {
+  std::array<uint8_t, 16> storage{};
+  BitWriter writer{storage};
+  writer.write(0b101, 3);
+  writer.write(0xDEADBEEFCAFEBABEULL, 64);
+  writer.write(0, 1);
+  EXPECT_EQ(writer.bits_written(), 68);
+  EXPECT_EQ(writer.bytes_written(), 9);
+  writer.flush();
+
+  BitReader reader{storage};
+  EXPECT_EQ(reader.read(3), 0b101);
+  EXPECT_EQ(reader.read(64), 0xDEADBEEFCAFEBABEULL);
+  EXPECT_EQ(reader.read(1), 0);
+}
+
+TEST(BitStream, WritesCrossingWordBoundaries) {
+  // Every width at every bit offset, so that writes and reads straddle stored words and the window end
+  std::vector<uint8_t> storage(64 * 64 * 8 + 8, 0xFF);
+  BitWriter writer{storage};
+  for (unsigned offset = 1; offset <= 64; ++offset) {
+    for (unsigned width = 1; width <= 64; ++width) {
+      writer.write(0b1, offset % 7 + 1);
+      writer.write(0xA5C3F00F12345678ULL * width, width);
+    }
+  }
+  writer.write(0, 0);
+  writer.flush();
+  EXPECT_EQ(storage[writer.bytes_written() - 1] & ((1U << (writer.bytes_written() * 8 - writer.bits_written())) - 1), 0);
+
+  BitReader reader{std::span{storage}.first(writer.bytes_written())};
+  for (unsigned offset = 1; offset <= 64; ++offset) {
+    for (unsigned width = 1; width <= 64; ++width) {
+      ASSERT_EQ(reader.read(offset % 7 + 1), 0b1);
+      const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+      ASSERT_EQ(reader.read(width), 0xA5C3F00F12345678ULL * width & mask) << offset << " " << width;
+    }
+  }
+  EXPECT_EQ(reader.bits_read(), writer.bits_written());
+  EXPECT_EQ(reader.read(0), 0);
+  // Past the end of the storage
+  EXPECT_EQ(reader.read(64), 0);
+}
+
+TEST(XorFloatCompression, FirstValueIsStoredRaw) {
+  EXPECT_EQ(encode_and_verify_roundtrip({3.14}), 64);
+}
+
+TEST(XorFloatCompression, RepeatedValueTakesSingleBit) {
+  EXPECT_EQ(encode_and_verify_roundtrip({42.5, 42.5, 42.5, 42.5}), 64 + 3);
+}
+
+TEST(XorFloatCompression, SlowlyVaryingValuesAreSmallerThanRaw) {
+  std::vector<double> latencies{};
+  for (int i = 0; i < 1000; ++i) {
+    latencies.push_back(100.0 + (i % 7) * 0.25);
+  }
+  EXPECT_LT(encode_and_verify_roundtrip(latencies), latencies.size() * 64 / 4);
+}
+
+TEST(XorFloatCompression, SpecialValues) {
+  encode_and_verify_roundtrip({0.0, -0.0, std::numeric_limits<double>::infinity(),
+                               -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN(),
+                               std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::max(),
+                               std::numeric_limits<double>::lowest(), 1.0, -1.0});
+}
+
+TEST(XorFloatCompression, ResidualWithAllBitsMeaningful) {
+  // XOR of these two values has both the most and the least significant bit set
+  encode_and_verify_roundtrip({std::bit_cast<double>(0x0000000000000000ULL), std::bit_cast<double>(0x8000000000000001ULL),
+                               std::bit_cast<double>(0x0000000000000000ULL)});
+}
+
+TEST(XorFloatCompression, IsUsableInConstantExpression) {
+  constexpr auto encoded_bits = [] {
+    std::array<uint8_t, 3 * XorFloatEncoder::max_encoded_bytes> storage{};
+    BitWriter writer{storage};
+    XorFloatEncoder encoder{};
+    encoder.encode(1.5, writer);
+    encoder.encode(1.5, writer);
+    encoder.encode(1.75, writer);
+    return writer.bits_written();
+  }();
+  static_assert(encoded_bits < 3 * 64);
+}
@@ -145,3 +145,90 @@ TEST(PlaceholderMatching, ParsePrecisionSpecifier) {
   EXPECT_FALSE(result.at(0).matches<float>());
   EXPECT_FALSE(result.at(0).matches<const char *>());
 }
+
+TEST(PlaceholderSpecificationParsing, AllParts) {
+  constexpr auto specification = parse_placeholder_specification("%-12.4lld rest");
+  static_assert(specification.has_value());
+  EXPECT_EQ(specification->flag, '-');
+  EXPECT_EQ(specification->width, 12);
+  EXPECT_EQ(specification->precision, 4);
+  EXPECT_EQ(specification->specifier, 'd');
+  EXPECT_EQ(specification->length, 9);
+  EXPECT_EQ(specification->argument_count(), 1);
+}
+
+TEST(PlaceholderSpecificationParsing, OptionalParts) {
+  const auto plain = parse_placeholder_specification("%u");
+  ASSERT_TRUE(plain);
+  EXPECT_EQ(plain->flag, '\0');
+  EXPECT_FALSE(plain->width);
+  EXPECT_FALSE(plain->precision);
+
+  const auto empty_precision = parse_placeholder_specification("%.f");
+  ASSERT_TRUE(empty_precision);
+  EXPECT_EQ(empty_precision->precision, 0);
+
+  const auto from_arguments = parse_placeholder_specification("%0*.*jo");
+  ASSERT_TRUE(from_arguments);
+  EXPECT_EQ(from_arguments->flag, '0');
+  EXPECT_TRUE(from_arguments->width_from_argument);
+  EXPECT_TRUE(from_arguments->precision_from_argument);
+  EXPECT_EQ(from_arguments->argument_count(), 3);
+  EXPECT_EQ(from_arguments->length, 7);
+}
+
+TEST(PlaceholderSpecificationParsing, InvalidPlaceholder) {
+  EXPECT_FALSE(parse_placeholder_specification("text"));
+  EXPECT_FALSE(parse_placeholder_specification("%hf"));
+  EXPECT_FALSE(parse_placeholder_specification("%y"));
+}
+
+TEST(PlaceholderSpecificationParsing, NamedPlaceholder) {
+  constexpr auto specification = parse_placeholder_specification("%{order_id}-8.2f rest");
+  static_assert(specification.has_value());
+  EXPECT_EQ(specification->name_length, 8);
+  EXPECT_EQ(specification->flag, '-');
+  EXPECT_EQ(specification->width, 8);
+  EXPECT_EQ(specification->precision, 2);
+  EXPECT_EQ(specification->specifier, 'f');
+  EXPECT_EQ(specification->length, 16);
+
+  static_assert(parse_format_to_placeholder_matchers("%{id}u of %{name}s and %d").size() == 3);
+  EXPECT_TRUE(parse_format_to_placeholder_matchers("%{id}u").at(0).matches<unsigned int>());
+  EXPECT_FALSE(parse_placeholder_specification("%{}u"));
+  EXPECT_FALSE(parse_placeholder_specification("%{1st}u"));
+  EXPECT_FALSE(parse_placeholder_specification("%{order id}u"));
+  EXPECT_FALSE(parse_placeholder_specification("%{order_id"));
+}
+
+namespace {
+constexpr std::string_view named_format = "order %{order_id}u: %s";
+}
+
+TEST(FormatFragments, NamesOfPlaceholders) {
+  constexpr auto &fragments = format_fragments<named_format>;
+  static_assert(fragments.size() == 2);
+  static_assert(fragments[0].get_name(named_format) == "order_id");
+  static_assert(fragments[1].get_name(named_format).empty());
+  static_assert(named_format.substr(fragments[1].literal_offset, fragments[1].literal_length) == ": ");
+}
+
+namespace {
+constexpr std::string_view fragmented_format = "id=%u, 100%% of %-8s%c";
+}
+
+TEST(FormatFragments, SplitAtCompileTime) {
+  constexpr auto &fragments = format_fragments<fragmented_format>;
+  static_assert(fragments.size() == 4);
+  static_assert(fragmented_format.substr(fragments[0].literal_offset, fragments[0].literal_length) == "id=");
+  static_assert(fragments[0].placeholder->specifier == 'u');
+  static_assert(fragmented_format.substr(fragments[1].literal_offset, fragments[1].literal_length) == ", 100%");
+  static_assert(not fragments[1].placeholder);
+  static_assert(fragmented_format.substr(fragments[2].literal_offset, fragments[2].literal_length) == " of ");
+  static_assert(fragments[2].placeholder->flag == '-' and fragments[2].placeholder->width == 8U);
+  static_assert(fragments[2].first_argument == 1);
+  static_assert(fragments[3].literal_length == 0 and fragments[3].first_argument == 2);
+  static_assert(fragments[3].placeholder->specifier == 'c');
+  EXPECT_EQ(split_format("plain text").size(), 1);
+  EXPECT_TRUE(split_format("").empty());
+}
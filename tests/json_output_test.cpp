@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <json_output.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+std::string escape(const std::string_view string) {
+  std::string output{};
+  json::append_string(output, string);
+  return output;
+}
+
+// Escaping a byte at a time, as reference for the word at a time escaper
+std::string escape_reference(const std::string_view string) {
+  std::string output{"\""};
+  for (const char character: string) {
+    if (json::needs_escape(character)) {
+      json::append_escaped_character(output, character);
+    } else {
+      output.push_back(character);
+    }
+  }
+  return output + "\"";
+}
+
+}
+
+TEST(JsonOutput, EscapeStrings) {
+  EXPECT_EQ(escape(""), R"("")");
+  EXPECT_EQ(escape("plain"), R"("plain")");
+  EXPECT_EQ(escape("say \"hi\"\n"), R"("say \"hi\"\n")");
+  EXPECT_EQ(escape("C:\\path\twith tab"), R"("C:\\path\twith tab")");
+  EXPECT_EQ(escape(std::string{"\x01\x1f\x7f", 3}), "\"\\u0001\\u001f\x7f\"");
+  EXPECT_EQ(escape("zażółć"), "\"zażółć\"");
+
+  // Escaped characters at every position of words, preceded and followed by bytes that may be flagged falsely
+  for (size_t position = 0; position < 24; ++position) {
+    for (const char special: {'"', '\\', '\n', '\0', '\x1f'}) {
+      std::string string(24, 'x');
+      string[position] = special;
+      if (position + 1 < string.size()) {
+        string[position + 1] = '!';
+      }
+      EXPECT_EQ(escape(string), escape_reference(string)) << position;
+    }
+  }
+}
+
+TEST(JsonOutput, Numbers) {
+  std::string output{};
+  json::append_signed(output, std::numeric_limits<int64_t>::min());
+  output.push_back(' ');
+  json::append_unsigned(output, std::numeric_limits<uint64_t>::max());
+  output.push_back(' ');
+  json::append_double(output, 0.1);
+  output.push_back(' ');
+  json::append_double(output, -2.5e-300);
+  output.push_back(' ');
+  json::append_double(output, std::numeric_limits<double>::infinity());
+  EXPECT_EQ(output, "-9223372036854775808 18446744073709551615 0.1 -2.5e-300 null");
+}
+
+TEST(JsonOutput, RecordWithTypedArguments) {
+  constexpr std::string_view format = "order %{order_id}u at %.2f by %{trader}s %c %p";
+  const decoder::SiteInfo site{.file_hash = 0, .line = 7, .file = "orders.cpp", .format = std::string{format},
+          .argument_types = {}, .program = decoder::RenderProgram::compile(format), .sampling_rate = 1,
+          .level = protocol::Level::error};
+  const std::vector<protocol::ArgumentValue> arguments{
+          protocol::make_argument_value(42U), protocol::make_argument_value(9.5),
+          protocol::make_argument_value("a \"quoted\" name"), protocol::make_argument_value('y'),
+          protocol::make_argument_value(reinterpret_cast<const void *>(0xBEEF))};
+  const protocol::RecordHeader header{.length = 0, .kind = protocol::RecordKind::log, .reserved = 0, .site_id = 0,
+          .thread_id = 2, .timestamp = 1'000'000'123};
+  std::string output{};
+  json::append_record(output, header, site, arguments);
+  EXPECT_EQ(output, R"({"timestamp":1000000123,"thread":2,"level":"error","file":"orders.cpp","line":7,)"
+                    R"("format":"order %{order_id}u at %.2f by %{trader}s %c %p",)"
+                    R"("message":"order 42 at 9.50 by a \"quoted\" name y 0xbeef",)"
+                    R"("args":{"order_id":42,"arg1":9.5,"trader":"a \"quoted\" name","arg3":"y","arg4":"0xbeef"}})");
+
+  output.clear();
+  json::append_record(output, header, site, std::span{arguments}.first(1));
+  EXPECT_TRUE(output.ends_with(R"("args":{"order_id":42,"arg1":null,"trader":null,"arg3":null,"arg4":null}})"));
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <record_filter.hpp>
+#include "test_records.hpp"
+
+using namespace log4tiny;
+using namespace log4tiny::decoder;
+using namespace log4tiny::test;
+
+namespace {
+
+protocol::RecordHeader header_of(const std::vector<uint8_t> &record) {
+  protocol::RecordHeader header{};
+  std::memcpy(&header, record.data(), sizeof(header));
+  return header;
+}
+
+const SiteInfo site{.file_hash = RecordFilter::hash_file("src/orders.cpp"), .line = 10, .file = "src/orders.cpp",
+        .format = "order %s filled at %f, quantity %u",
+        .argument_types = {protocol::ArgumentType::string, protocol::ArgumentType::floating,
+                           protocol::ArgumentType::unsigned_int}};
+
+}
+
+TEST(ArgumentPredicateParsing, ValidPredicates) {
+  const auto integer = parse_argument_predicate("arg0 > 500");
+  ASSERT_TRUE(integer);
+  EXPECT_EQ(integer->argument_index, 0);
+  EXPECT_EQ(integer->comparison, Comparison::greater);
+  EXPECT_EQ(std::get<int64_t>(integer->value), 500);
+
+  const auto floating = parse_argument_predicate("arg12<=-2.5");
+  ASSERT_TRUE(floating);
+  EXPECT_EQ(floating->argument_index, 12);
+  EXPECT_EQ(floating->comparison, Comparison::less_or_equal);
+  EXPECT_EQ(std::get<double>(floating->value), -2.5);
+
+  const auto string = parse_argument_predicate("arg1 == ORD-1");
+  ASSERT_TRUE(string);
+  EXPECT_EQ(string->comparison, Comparison::equal);
+  EXPECT_EQ(std::get<std::string>(string->value), "ORD-1");
+}
+
+TEST(ArgumentPredicateParsing, InvalidPredicates) {
+  EXPECT_FALSE(parse_argument_predicate("x > 5"));
+  EXPECT_FALSE(parse_argument_predicate("arg > 5"));
+  EXPECT_FALSE(parse_argument_predicate("arg0 ~ 5"));
+}
+
+TEST(RecordFilter, SiteConditions) {
+  const auto record = make_log_record(1, 0, "A", 1.5, 10U);
+  RecordFilter filter{};
+  EXPECT_TRUE(filter.is_empty());
+  filter.file_hash = RecordFilter::hash_file("src/orders.cpp");
+  filter.format_substring = "filled";
+  EXPECT_TRUE(filter.matches(header_of(record), site, record));
+
+  RecordFilter other_file{};
+  other_file.file_hash = RecordFilter::hash_file("src/other.cpp");
+  EXPECT_FALSE(other_file.matches(header_of(record), site, record));
+
+  RecordFilter other_site{};
+  other_site.site_id = 2;
+  EXPECT_FALSE(other_site.matches(header_of(record), site, record));
+}
+
+TEST(RecordFilter, ArgumentPredicatesReadBinaryValues) {
+  RecordFilter filter{};
+  filter.argument_predicates.push_back(*parse_argument_predicate("arg2 > 500"));
+  filter.argument_predicates.push_back(*parse_argument_predicate("arg0 == ORD-7"));
+
+  const auto matching = make_log_record(1, 0, "ORD-7", 1.5, 501U);
+  const auto too_small = make_log_record(1, 0, "ORD-7", 1.5, 500U);
+  const auto other_order = make_log_record(1, 0, "ORD-8", 1.5, 1000U);
+  EXPECT_TRUE(filter.matches(header_of(matching), site, matching));
+  EXPECT_FALSE(filter.matches(header_of(too_small), site, too_small));
+  EXPECT_FALSE(filter.matches(header_of(other_order), site, other_order));
+}
+
+TEST(RecordFilter, NumericComparisonAcrossTypes) {
+  protocol::ArgumentValue unsigned_value{.type = protocol::ArgumentType::unsigned_int, .unsigned_int = 7, .string = {}};
+  protocol::ArgumentValue floating_value{.type = protocol::ArgumentType::floating, .floating = 2.5, .string = {}};
+  EXPECT_TRUE(evaluate(*parse_argument_predicate("arg0 > -1"), unsigned_value));
+  EXPECT_TRUE(evaluate(*parse_argument_predicate("arg0 == 7"), unsigned_value));
+  EXPECT_TRUE(evaluate(*parse_argument_predicate("arg0 > 2"), floating_value));
+  EXPECT_TRUE(evaluate(*parse_argument_predicate("arg0 < 2.75"), floating_value));
+  EXPECT_FALSE(evaluate(*parse_argument_predicate("arg0 == text"), floating_value));
+}
+
+TEST(RecordFilter, PredicateOnMissingArgumentDoesNotMatch) {
+  const auto record = make_log_record(1, 0, "A", 1.5, 10U);
+  RecordFilter filter{};
+  filter.argument_predicates.push_back(*parse_argument_predicate("arg5 > 0"));
+  EXPECT_FALSE(filter.matches(header_of(record), site, record));
+}
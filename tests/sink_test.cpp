@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sink.hpp>
+#include <unix_socket_sink.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+std::vector<uint8_t> make_record(const uint32_t length, const uint8_t fill) {
+  std::vector<uint8_t> record(length, fill);
+  const protocol::RecordHeader header{.length = length, .kind = protocol::RecordKind::log, .reserved = 0,
+          .site_id = fill, .thread_id = 0, .timestamp = 0};
+  std::memcpy(record.data(), &header, sizeof(header));
+  return record;
+}
+
+std::vector<uint8_t> read_file(const std::string &path) {
+  std::ifstream file{path, std::ios::binary};
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+int listen_on(const std::string &path, const SocketType type) {
+  const int fd = ::socket(AF_UNIX, static_cast<int>(type), 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  ::unlink(path.c_str());
+  EXPECT_EQ(::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)), 0);
+  EXPECT_EQ(::listen(fd, 1), 0);
+  return fd;
+}
+
+// Receive everything from the first connection. For SOCK_SEQPACKET sizes of separate messages are reported as well
+std::pair<std::vector<uint8_t>, std::vector<size_t>> receive_all(const int listener) {
+  const int connection = ::accept(listener, nullptr, nullptr);
+  std::vector<uint8_t> received{};
+  std::vector<size_t> message_sizes{};
+  std::vector<uint8_t> buffer(1U << 20);
+  for (ssize_t length; (length = ::recv(connection, buffer.data(), buffer.size(), 0)) > 0;) {
+    received.insert(received.end(), buffer.begin(), buffer.begin() + length);
+    message_sizes.push_back(static_cast<size_t>(length));
+  }
+  ::close(connection);
+  return {received, message_sizes};
+}
+
+// Allocator recording allocations, delegating to the default one
+class CountingAllocator : public BufferAllocator {
+public:
+  void *allocate(const size_t size) override {
+    allocated += size;
+    return default_allocator().allocate(size);
+  }
+
+  void deallocate(void *memory, const size_t size) override {
+    deallocated += size;
+    default_allocator().deallocate(memory, size);
+  }
+
+  void advise(void *memory, const size_t size) override {
+    default_allocator().advise(memory, size);
+  }
+
+  void populate(void *memory, const size_t size) override {
+    default_allocator().populate(memory, size);
+  }
+
+  size_t allocated{0};
+  size_t deallocated{0};
+};
+
+}
+
+TEST(FileSink, WritesHeaderAndBatchedRecords) {
+  const std::string path = testing::TempDir() + "log4tiny_file_sink_test.bin";
+  const auto first = make_record(32, 1);
+  const auto second = make_record(64, 2);
+  {
+    FileSink sink{path, 64};
+    sink.write(first);
+    sink.write(second);
+  }
+
+  const auto content = read_file(path);
+  ASSERT_EQ(content.size(), sizeof(protocol::FileHeader) + first.size() + second.size());
+  protocol::FileHeader header{};
+  std::memcpy(&header, content.data(), sizeof(header));
+  EXPECT_EQ(header.magic, protocol::file_magic);
+  EXPECT_TRUE(std::equal(first.begin(), first.end(), content.begin() + sizeof(header)));
+  EXPECT_TRUE(std::equal(second.begin(), second.end(), content.begin() + sizeof(header) + first.size()));
+}
+
+TEST(FileSink, BatchComesFromGivenAllocator) {
+  CountingAllocator allocator{};
+  {
+    FileSink sink{testing::TempDir() + "log4tiny_allocator_test.bin", 4096, false, allocator};
+    sink.write(make_record(32, 1));
+  }
+  EXPECT_EQ(allocator.allocated, 4096);
+  EXPECT_EQ(allocator.deallocated, 4096);
+}
+
+// Every option is best-effort - memory has to be usable whether or not kernel grants huge pages or locking
+TEST(MappedBufferAllocator, MemoryIsUsableWithAllOptions) {
+  for (const auto huge_pages: {HugePages::none, HugePages::transparent, HugePages::explicit_pool}) {
+    MappedBufferAllocator allocator{{.huge_pages = huge_pages, .prefault = true, .lock = true}};
+    const size_t size = huge_page_size + 100;
+    auto *memory = static_cast<uint8_t *>(allocator.allocate(size));
+    ASSERT_NE(memory, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(memory) % 4096, 0);
+    EXPECT_EQ(memory[0], 0);
+    std::memset(memory, 0xAB, size);
+    EXPECT_EQ(memory[size - 1], 0xAB);
+    allocator.deallocate(memory, size);
+  }
+}
+
+TEST(UnixSocketSink, StreamSocketReceivesHeaderAndRecords) {
+  const std::string path = testing::TempDir() + "log4tiny_stream_sink_test.sock";
+  const int listener = listen_on(path, SocketType::stream);
+  std::vector<uint8_t> received{};
+  std::thread receiver([&] { received = receive_all(listener).first; });
+
+  size_t sent_bytes{0};
+  {
+    UnixSocketSink sink{path, SocketType::stream, 1024};
+    for (uint8_t i = 0; i < 100; ++i) {
+      const auto record = make_record(48, i);
+      sink.write(record);
+      sent_bytes += record.size();
+    }
+    EXPECT_EQ(sink.get_dropped_bytes(), 0);
+  }
+  receiver.join();
+  ::close(listener);
+
+  ASSERT_EQ(received.size(), sizeof(protocol::FileHeader) + sent_bytes);
+  EXPECT_EQ(received.at(sizeof(protocol::FileHeader) + 99 * 48 + sizeof(protocol::RecordHeader)), 99);
+}
+
+TEST(UnixSocketSink, SeqpacketMessagesHoldCompleteRecords) {
+  const std::string path = testing::TempDir() + "log4tiny_seqpacket_sink_test.sock";
+  const int listener = listen_on(path, SocketType::seqpacket);
+  std::vector<size_t> message_sizes{};
+  std::thread receiver([&] { message_sizes = receive_all(listener).second; });
+  {
+    UnixSocketSink sink{path, SocketType::seqpacket, 100};
+    for (uint8_t i = 0; i < 10; ++i) {
+      sink.write(make_record(48, i));
+    }
+  }
+  receiver.join();
+  ::close(listener);
+
+  // Header followed by 5 batches of 2 records
+  ASSERT_EQ(message_sizes.size(), 6);
+  EXPECT_EQ(message_sizes.at(0), sizeof(protocol::FileHeader));
+  for (size_t message = 1; message < message_sizes.size(); ++message) {
+    EXPECT_EQ(message_sizes.at(message), 96);
+  }
+}
+
+TEST(UnixSocketSink, MissingCollectorDropsBatches) {
+  UnixSocketSink sink{testing::TempDir() + "log4tiny_missing_collector.sock", SocketType::stream, 1024};
+  sink.write(make_record(48, 0));
+  sink.flush();
+  EXPECT_EQ(sink.get_dropped_bytes(), 48);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <decoder.hpp>
+#include <protocol.hpp>
+
+// Site and log records built the way producer writes them, for tests of the decoding side
+namespace log4tiny::test {
+
+template<typename... T>
+std::vector<uint8_t> make_site_record(const uint32_t site_id, const std::string_view format) {
+  const protocol::RecordHeader header{.length = static_cast<uint32_t>(protocol::site_record_length<T...>("file.cpp", format)),
+          .kind = protocol::RecordKind::site, .reserved = 0, .site_id = site_id, .thread_id = 0, .timestamp = 0};
+  std::vector<uint8_t> record(header.length);
+  protocol::write_site_record<T...>(record.data(), header, 0xABCD, 42, "file.cpp", format);
+  std::memcpy(record.data(), &header.length, sizeof(header.length));
+  return record;
+}
+
+template<typename... T>
+std::vector<uint8_t> make_log_record(const uint32_t site_id, const uint64_t timestamp, const T &... args) {
+  const auto length = static_cast<uint32_t>(
+          protocol::align_record_length(sizeof(protocol::RecordHeader) + (protocol::encoded_size(args) + ... + 0)));
+  const protocol::RecordHeader header{.length = length, .kind = protocol::RecordKind::log, .reserved = 0,
+          .site_id = site_id, .thread_id = 0, .timestamp = timestamp};
+  std::vector<uint8_t> record(length);
+  std::memcpy(record.data(), &header, sizeof(header));
+  [[maybe_unused]] auto *cursor = record.data() + sizeof(header);
+  ((cursor = protocol::encode_argument(cursor, args)), ...);
+  return record;
+}
+
+// Message as rendered by decoder from records of a site with given format
+template<typename... T>
+std::string render(const std::string_view format, const T &... args) {
+  const auto site = decoder::parse_site_record(make_site_record<T...>(0, format));
+  const auto arguments = decoder::decode_arguments(*site, make_log_record(0, 0, args...));
+  std::string output{};
+  site->program.render(output, *arguments);
+  return output;
+}
+
+}
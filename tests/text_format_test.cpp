@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+#include <text_format.hpp>
+
+using namespace log4tiny;
+
+// Renderer has to produce exactly the same text as printf for every flag, width and precision combination
+
+namespace {
+
+const std::vector<std::string> flags = {"", "-", "+", " ", "#", "0"};
+const std::vector<std::string> widths = {"", "1", "8", "25"};
+const std::vector<std::string> precisions = {"", ".0", ".1", ".3", ".12"};
+
+template<typename T>
+std::string printf_reference(const std::string &format, const T value) {
+  char buffer[512];
+  std::snprintf(buffer, sizeof(buffer), format.c_str(), value);
+  return buffer;
+}
+
+template<typename Render>
+void expect_same_as_printf(const std::string &specifiers, const std::string &length, Render &&render) {
+  for (const char specifier: specifiers) {
+    for (const auto &flag: flags) {
+      for (const auto &width: widths) {
+        for (const auto &precision: precisions) {
+          const std::string placeholder = "%" + flag + width + precision + specifier;
+          const auto specification = parse_placeholder_specification(placeholder);
+          ASSERT_TRUE(specification) << placeholder;
+          render("%" + flag + width + precision + length + specifier,
+                 text::ResolvedSpecification::resolve(*specification));
+        }
+      }
+    }
+  }
+}
+
+}
+
+TEST(TextFormat, SignedIntegers) {
+  for (const long long value: {0LL, 1LL, -1LL, 7LL, 42LL, -99LL, 100LL, 123456789LL, -987654321012LL,
+                               std::numeric_limits<long long>::max(), std::numeric_limits<long long>::min()}) {
+    expect_same_as_printf("di", "ll", [value](const std::string &format, const text::ResolvedSpecification &specification) {
+      std::string output{};
+      text::append_signed_integer(output, specification, value);
+      EXPECT_EQ(output, printf_reference(format, value)) << format << " " << value;
+    });
+  }
+}
+
+TEST(TextFormat, UnsignedIntegers) {
+  for (const unsigned long long value: {0ULL, 1ULL, 8ULL, 15ULL, 255ULL, 4096ULL, 0xDEADBEEFULL,
+                                        std::numeric_limits<unsigned long long>::max()}) {
+    expect_same_as_printf("uoxX", "ll", [value](const std::string &format, const text::ResolvedSpecification &specification) {
+      std::string output{};
+      text::append_integer(output, specification, value);
+      EXPECT_EQ(output, printf_reference(format, value)) << format << " " << value;
+    });
+  }
+}
+
+TEST(TextFormat, FloatingPoint) {
+  for (const double value: {0.0, -0.0, 1.0, -1.5, 0.1, 3.14159265358979, 1e-7, 123456.789, -9.999999e21, 1e300,
+                            std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::max(),
+                            std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                            std::numeric_limits<double>::quiet_NaN()}) {
+    expect_same_as_printf("fFeEgGaA", "", [value](const std::string &format, const text::ResolvedSpecification &specification) {
+      std::string output{};
+      text::append_floating(output, specification, value);
+      EXPECT_EQ(output, printf_reference(format, value)) << format << " " << value;
+    });
+  }
+}
+
+TEST(TextFormat, CharactersAndStrings) {
+  for (const auto &flag: {"", "-"}) {
+    for (const auto &width: {"", "3", "10"}) {
+      for (const auto &precision: {"", ".0", ".2", ".20"}) {
+        const std::string string_format = std::string{"%"} + flag + width + precision + "s";
+        std::string output{};
+        text::append_string(output, text::ResolvedSpecification::resolve(*parse_placeholder_specification(string_format)),
+                            "hello");
+        EXPECT_EQ(output, printf_reference(string_format, "hello")) << string_format;
+      }
+      const std::string character_format = std::string{"%"} + flag + width + "c";
+      std::string output{};
+      text::append_character(output, text::ResolvedSpecification::resolve(*parse_placeholder_specification(character_format)),
+                             'x');
+      EXPECT_EQ(output, printf_reference(character_format, 'x')) << character_format;
+    }
+  }
+}
+
+TEST(TextFormat, Pointers) {
+  const auto specification = text::ResolvedSpecification::resolve(*parse_placeholder_specification("%p"));
+  std::string output{};
+  text::append_pointer(output, specification, 0x7ffe1234);
+  text::append_pointer(output, specification, 0);
+  EXPECT_EQ(output, printf_reference("%p", reinterpret_cast<void *>(0x7ffe1234)) + printf_reference("%p", nullptr));
+}
+
+TEST(TextFormat, WidthAndPrecisionFromArguments) {
+  const auto placeholder = *parse_placeholder_specification("%*.*d");
+  std::string output{};
+  text::append_signed_integer(output, text::ResolvedSpecification::resolve(placeholder, 6, 3), 7);
+  text::append_signed_integer(output, text::ResolvedSpecification::resolve(placeholder, -6, -1), 7);
+  EXPECT_EQ(output, "   0077     ");
+}
+
+TEST(TextFormat, LengthModifiersTruncateIntegers) {
+  for (const char *format: {"%hhu", "%hhx", "%hu", "%hho", "%lu", "%llu", "%zu"}) {
+    const auto placeholder = *parse_placeholder_specification(format);
+    for (const unsigned value: {0U, 44U, 300U, 65535U, 70000U, 4000000000U}) {
+      std::string output{};
+      const std::vector arguments{protocol::make_argument_value(value)};
+      text::render_placeholder(output, placeholder, arguments);
+      EXPECT_EQ(output, printf_reference(format, static_cast<unsigned long>(value))) << format << " " << value;
+    }
+  }
+  for (const char *format: {"%hhd", "%hi", "%jd", "%td"}) {
+    const auto placeholder = *parse_placeholder_specification(format);
+    for (const int value: {0, -1, 127, 128, 300, -300, 40000, -70000}) {
+      std::string output{};
+      const std::vector arguments{protocol::make_argument_value(value)};
+      text::render_placeholder(output, placeholder, arguments);
+      EXPECT_EQ(output, printf_reference(format, static_cast<long>(value))) << format << " " << value;
+    }
+  }
+}
+
+TEST(TextFormat, IntegersWithoutLengthModifierAreInts) {
+  const auto render = [](const char *format, const auto value) {
+    std::string output{};
+    const std::vector arguments{protocol::make_argument_value(value)};
+    text::render_placeholder(output, *parse_placeholder_specification(format), arguments);
+    return output;
+  };
+  EXPECT_EQ(render("%u", -1), "4294967295");
+  EXPECT_EQ(render("%x", -1), "ffffffff");
+  EXPECT_EQ(render("%d", 4294967295U), "-1");
+  // Modifiers of 64-bit types keep the whole value
+  EXPECT_EQ(render("%lu", -1L), "18446744073709551615");
+  EXPECT_EQ(render("%llx", -1LL), "ffffffffffffffff");
+  EXPECT_EQ(render("%ld", 4294967295UL), "4294967295");
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <string>
+#include <unistd.h>
+#include <log4tiny.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+struct TextOutputTest : testing::Test {
+  void SetUp() override {
+    ASSERT_EQ(::pipe(fds.data()), 0);
+    set_text_output(fds[1]);
+  }
+
+  void TearDown() override {
+    set_text_output(-1);
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+
+  std::string read_output() {
+    std::string output(4096, '\0');
+    const auto length = ::read(fds[0], output.data(), output.size());
+    output.resize(length > 0 ? static_cast<size_t>(length) : 0);
+    return output;
+  }
+
+  std::array<int, 2> fds{};
+};
+
+}
+
+TEST_F(TextOutputTest, LineIsRenderedInProcess) {
+  const std::string name{"disk"};
+  tinylog("%s usage %3u%%, %.1f GiB free", name, 93U, 12.25)
+  const auto line = read_output();
+  // "YYYY-MM-DD HH:MM:SS.nnnnnnnnn [thread] file:line message"
+  ASSERT_GT(line.size(), 30);
+  EXPECT_EQ(line[4], '-');
+  EXPECT_EQ(line[19], '.');
+  EXPECT_EQ(line.substr(29, 2), " [");
+  EXPECT_NE(line.find("] " __FILE__ ":"), std::string::npos);
+  EXPECT_TRUE(line.ends_with(" disk usage  93%, 12.2 GiB free\n")) << line;
+}
+
+TEST_F(TextOutputTest, EveryCallWritesOneLine) {
+  for (int value = 0; value < 3; ++value) {
+    tinylog("value %d", value)
+  }
+  const auto output = read_output();
+  EXPECT_EQ(std::ranges::count(output, '\n'), 3);
+  EXPECT_NE(output.find("value 0\n"), std::string::npos);
+  EXPECT_NE(output.find("value 2\n"), std::string::npos);
+}
@@ -0,0 +1,721 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <backend.hpp>
+#include <decoder.hpp>
+#include <log4tiny.hpp>
+#include <mpsc_ring.hpp>
+#include <numa.hpp>
+#include <shm_transport.hpp>
+
+using namespace log4tiny;
+
+struct RingTest : testing::Test {
+  static constexpr size_t capacity = 256;
+
+  std::vector<std::span<const uint8_t>> read_all_records() {
+    std::vector<std::span<const uint8_t>> records{};
+    protocol::for_each_record(ring.readable(), [&records](std::span<const uint8_t> record) { records.push_back(record); });
+    return records;
+  }
+
+  uint8_t *reserve_record(const size_t length) {
+    auto *destination = ring.reserve(length);
+    if (destination != nullptr) {
+      const protocol::RecordHeader header{.length = static_cast<uint32_t>(length), .kind = protocol::RecordKind::log,
+              .reserved = 0, .site_id = 0, .thread_id = 0, .timestamp = 0};
+      std::memcpy(destination, &header, sizeof(header));
+    }
+    return destination;
+  }
+
+  RingControl control{};
+  alignas(8) std::array<uint8_t, capacity> data{};
+  SpscRing ring{&control, data.data(), capacity};
+};
+
+TEST_F(RingTest, ReserveCommitAndRelease) {
+  EXPECT_TRUE(ring.empty());
+  ASSERT_NE(reserve_record(64), nullptr);
+  EXPECT_TRUE(ring.empty());
+  ring.commit(64);
+  EXPECT_FALSE(ring.empty());
+  EXPECT_EQ(ring.readable().size(), 64);
+  ring.release(64);
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(RingTest, FullRingRejectsRecord) {
+  ASSERT_NE(reserve_record(200), nullptr);
+  ring.commit(200);
+  EXPECT_EQ(reserve_record(64), nullptr);
+  ring.release(200);
+  EXPECT_NE(reserve_record(64), nullptr);
+}
+
+TEST_F(RingTest, RecordIsNotSplitAtTheEnd) {
+  ASSERT_NE(reserve_record(200), nullptr);
+  ring.commit(200);
+  ring.release(200);
+
+  // Only 56 bytes are left till the end, so record is placed at the beginning and the rest is padded
+  EXPECT_EQ(reserve_record(64), data.data());
+  ring.commit(64);
+  EXPECT_EQ(read_all_records().size(), 0);
+  EXPECT_EQ(ring.readable().size(), 56);
+  ring.release(56);
+  EXPECT_EQ(read_all_records().size(), 1);
+}
+
+TEST_F(RingTest, DeferredCommitsArePublishedTogether) {
+  ASSERT_NE(reserve_record(64), nullptr);
+  ring.commit(64, false);
+  ASSERT_NE(reserve_record(32), nullptr);
+  ring.commit(32, false);
+  EXPECT_TRUE(ring.readable().empty());
+  EXPECT_EQ(control.write_index.load(), 0);
+
+  ring.publish();
+  EXPECT_EQ(control.write_index.load(), 96);
+  EXPECT_EQ(read_all_records().size(), 2);
+}
+
+TEST_F(RingTest, FullRingPublishesDeferredRecords) {
+  ASSERT_NE(reserve_record(200), nullptr);
+  ring.commit(200, false);
+  EXPECT_EQ(reserve_record(64), nullptr);
+  EXPECT_EQ(ring.readable().size(), 200);
+}
+
+TEST_F(RingTest, ConsumerReadsWriteIndexOnlyWhenCaughtUp) {
+  ASSERT_NE(reserve_record(64), nullptr);
+  ring.commit(64);
+  EXPECT_EQ(ring.readable().size(), 64);
+  EXPECT_EQ(control.cached_write_index.load(), 64);
+
+  // Not consumed yet, so the new record is not seen
+  ASSERT_NE(reserve_record(32), nullptr);
+  ring.commit(32);
+  EXPECT_EQ(ring.readable().size(), 64);
+  ring.release(64);
+  EXPECT_EQ(ring.readable().size(), 32);
+  EXPECT_EQ(control.cached_write_index.load(), 96);
+}
+
+struct MpscRingTest : testing::Test {
+  static constexpr size_t capacity = 4096;
+
+  // Record holding producer index and sequence number in its header
+  static bool write_record(MpscRing &ring, const uint32_t producer, const uint64_t sequence, const size_t length) {
+    auto *destination = ring.reserve(length);
+    if (destination == nullptr) {
+      return false;
+    }
+    const protocol::RecordHeader header{.length = 0, .kind = protocol::RecordKind::log, .reserved = 0, .site_id = 0,
+            .thread_id = producer, .timestamp = sequence};
+    protocol::write_record_header(destination, header);
+    ring.commit(destination, length);
+    return true;
+  }
+
+  RingControl control{};
+  alignas(8) std::array<uint8_t, capacity> data{};
+  MpscRing ring{&control, data.data(), capacity};
+};
+
+TEST_F(MpscRingTest, RecordIsVisibleOnlyAfterCommit) {
+  auto *first = ring.reserve(32);
+  ASSERT_NE(first, nullptr);
+  ASSERT_TRUE(write_record(ring, 1, 0, 64));
+  // Second record is committed, but it follows uncommitted one
+  EXPECT_TRUE(ring.readable().empty());
+  ring.commit(first, 32);
+  EXPECT_EQ(ring.readable().size(), 96);
+  ring.release(96);
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.reserve(capacity + 8), nullptr);
+}
+
+TEST_F(MpscRingTest, RecordsOfConcurrentProducersAreReadInOrder) {
+  constexpr uint32_t producer_count = 4;
+  constexpr uint64_t records_per_producer = 10000;
+  std::vector<std::thread> producers{};
+  for (uint32_t producer = 0; producer < producer_count; ++producer) {
+    producers.emplace_back([this, producer] {
+      for (uint64_t sequence = 0; sequence < records_per_producer;) {
+        // Different lengths make records wrap at different offsets
+        if (write_record(ring, producer, sequence, 24 + 8 * ((sequence + producer) % 5))) {
+          ++sequence;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::array<uint64_t, producer_count> next_sequence{};
+  uint64_t received{0};
+  bool in_order{true};
+  while (received < producer_count * records_per_producer) {
+    const auto readable = ring.readable();
+    if (readable.empty()) {
+      std::this_thread::yield();
+      continue;
+    }
+    protocol::for_each_record(readable, [&](std::span<const uint8_t> record) {
+      protocol::RecordHeader header{};
+      std::memcpy(&header, record.data(), sizeof(header));
+      in_order = in_order and header.timestamp == next_sequence[header.thread_id]++;
+      ++received;
+    });
+    ring.release(readable.size());
+  }
+  for (auto &producer: producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(in_order);
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST(Producer, CurrentCpuComesFromRseqArea) {
+  const int cpu = detail::current_cpu();
+  if (cpu < 0) {
+    GTEST_SKIP() << "rseq is not available";
+  }
+  // Thread may migrate in between, but not when pinned to a single CPU
+  cpu_set_t original{};
+  ASSERT_EQ(sched_getaffinity(0, sizeof(original), &original), 0);
+  cpu_set_t single{};
+  CPU_SET(sched_getcpu(), &single);
+  ASSERT_EQ(sched_setaffinity(0, sizeof(single), &single), 0);
+  EXPECT_EQ(detail::current_cpu(), sched_getcpu());
+  sched_setaffinity(0, sizeof(original), &original);
+}
+
+TEST(Numa, ParseSysfsList) {
+  EXPECT_EQ(numa::parse_list("0-3,8,10-11"), (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(numa::parse_list("5"), (std::vector<unsigned>{5}));
+  EXPECT_TRUE(numa::parse_list("").empty());
+  EXPECT_GE(numa::node_count(), 1);
+}
+
+TEST(Protocol, ArgumentTypes) {
+  EXPECT_EQ(protocol::argument_type_of<int>(), protocol::ArgumentType::signed_int);
+  EXPECT_EQ(protocol::argument_type_of<unsigned long>(), protocol::ArgumentType::unsigned_int);
+  EXPECT_EQ(protocol::argument_type_of<float>(), protocol::ArgumentType::floating);
+  EXPECT_EQ(protocol::argument_type_of<char>(), protocol::ArgumentType::character);
+  EXPECT_EQ(protocol::argument_type_of<uint8_t>(), protocol::ArgumentType::character);
+  EXPECT_EQ(protocol::argument_type_of<const char *>(), protocol::ArgumentType::string);
+  EXPECT_EQ(protocol::argument_type_of<char[6]>(), protocol::ArgumentType::string);
+  EXPECT_EQ(protocol::argument_type_of<std::string>(), protocol::ArgumentType::string);
+  EXPECT_EQ(protocol::argument_type_of<double *>(), protocol::ArgumentType::pointer);
+}
+
+TEST(Protocol, EncodeAndDecodeArguments) {
+  std::array<uint8_t, 128> buffer{};
+  const std::string text = "text";
+  auto *cursor = buffer.data();
+  cursor = protocol::encode_argument(cursor, -42);
+  cursor = protocol::encode_argument(cursor, 42U);
+  cursor = protocol::encode_argument(cursor, 2.5F);
+  cursor = protocol::encode_argument(cursor, 'x');
+  cursor = protocol::encode_argument(cursor, text);
+  EXPECT_EQ(cursor - buffer.data(), 8 + 8 + 8 + 1 + 4 + 4);
+  EXPECT_EQ(protocol::encoded_size(text), 8);
+
+  const uint8_t *read_cursor = buffer.data();
+  EXPECT_EQ(protocol::decode_argument(protocol::ArgumentType::signed_int, read_cursor).signed_int, -42);
+  EXPECT_EQ(protocol::decode_argument(protocol::ArgumentType::unsigned_int, read_cursor).unsigned_int, 42);
+  EXPECT_EQ(protocol::decode_argument(protocol::ArgumentType::floating, read_cursor).floating, 2.5);
+  EXPECT_EQ(protocol::decode_argument(protocol::ArgumentType::character, read_cursor).character, 'x');
+  EXPECT_EQ(protocol::decode_argument(protocol::ArgumentType::string, read_cursor).string, "text");
+  EXPECT_EQ(read_cursor, cursor);
+}
+
+TEST(SharedMemoryTransport, RecordBatchPublishesRecordsAtItsEnd) {
+  const std::string name = "/log4tiny_batch_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+  const auto count_records = [&segment] {
+    size_t records{0};
+    shm::drain(*segment, [&records](std::span<const uint8_t>) { ++records; });
+    return records;
+  };
+
+  {
+    const RecordBatch batch{};
+    tinylog("first %d", 1)
+    {
+      const RecordBatch nested{};
+      tinylog("second %d", 2)
+    }
+    EXPECT_EQ(count_records(), 0);
+    tinylog("third %d", 3)
+  }
+  // Site record of every call site followed by the record itself
+  EXPECT_EQ(count_records(), 6);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(Statistics, CountersOfExitedThreadsAreKept) {
+  const std::string name = "/log4tiny_statistics_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 4096);
+  const auto before = collect_statistics();
+
+  // Nothing drains the ring, so it fills up
+  std::thread([] {
+    for (int i = 0; i < 200; ++i) {
+      tinylog("value %d", i)
+    }
+  }).join();
+
+  const auto after = collect_statistics();
+  const size_t record_length = protocol::align_record_length(sizeof(protocol::RecordHeader) + sizeof(uint64_t));
+  EXPECT_EQ(after.records_written + after.dropped_records - before.records_written - before.dropped_records, 201);
+  EXPECT_GT(after.dropped_records, before.dropped_records);
+  EXPECT_GE(after.bytes_written - before.bytes_written, (after.records_written - before.records_written - 1) * record_length);
+  EXPECT_GT(after.ring_high_water_mark, 4096 - record_length);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(SharedMemoryTransport, RecordsOfEveryThreadAreDrainedByConsumer) {
+  const std::string name = "/log4tiny_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+
+  std::thread([] { tinylog("from thread %d %s", 1, "abc") }).join();
+  tinylog("from main %u", 7U)
+
+  size_t site_records{0};
+  std::vector<protocol::RecordHeader> log_records{};
+  for (uint32_t slot = 0; slot < segment->header()->slot_count; ++slot) {
+    auto ring = segment->ring(slot);
+    const auto readable = ring.readable();
+    protocol::for_each_record(readable, [&](std::span<const uint8_t> record) {
+      protocol::RecordHeader header{};
+      std::memcpy(&header, record.data(), sizeof(header));
+      if (header.kind == protocol::RecordKind::site) {
+        ++site_records;
+      } else {
+        log_records.push_back(header);
+      }
+    });
+    ring.release(readable.size());
+  }
+
+  EXPECT_EQ(site_records, 2);
+  ASSERT_EQ(log_records.size(), 2);
+  EXPECT_NE(log_records.at(0).site_id, log_records.at(1).site_id);
+  EXPECT_NE(log_records.at(0).thread_id, log_records.at(1).thread_id);
+  EXPECT_EQ(segment->slot_header(0)->state.load(), shm::SlotState::retired);
+  // Binding is best-effort, e.g. containers may forbid mbind()
+  const auto node = segment->slot_header(1)->numa_node.load();
+  EXPECT_TRUE(node == -1 or node == numa::current_node());
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+namespace {
+
+// Allocator recording ranges it populates, prefaulting them
+class PopulateRecordingAllocator : public MappedBufferAllocator {
+public:
+  PopulateRecordingAllocator() : MappedBufferAllocator({.prefault = true}) {}
+
+  void populate(void *memory, const size_t size) override {
+    populated.emplace_back(static_cast<uint8_t *>(memory), size);
+    MappedBufferAllocator::populate(memory, size);
+  }
+
+  std::vector<std::pair<uint8_t *, size_t>> populated{};
+};
+
+// Allocator failing to populate, e.g. when memory cannot be locked
+class FailingAllocator : public MappedBufferAllocator {
+public:
+  void populate(void *, size_t) override {
+    throw std::system_error(ENOMEM, std::generic_category(), "mlock");
+  }
+};
+
+}
+
+// Rings are prefaulted only after they are bound to a NUMA node, so that their pages are allocated on that node
+TEST(SharedMemoryTransport, RingsArePopulatedWhenClaimed) {
+  const std::string name = "/log4tiny_populate_test_" + std::to_string(getpid());
+  PopulateRecordingAllocator allocator{};
+  auto source = shm::attach(name, 4, 4096, allocator);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+  // Headers are populated when the segment is created, at the start of the producer's mapping
+  ASSERT_EQ(allocator.populated.size(), 1);
+  const auto *producer_base = allocator.populated.at(0).first;
+  const auto *base = reinterpret_cast<const uint8_t *>(segment->header());
+  const auto populated_rings = [&] {
+    size_t rings{0};
+    for (const auto &[memory, size]: allocator.populated) {
+      for (uint32_t slot = 0; slot < segment->header()->slot_count; ++slot) {
+        rings += memory == producer_base + (segment->ring_data(slot) - base) and size == 4096 ? 1 : 0;
+      }
+    }
+    return rings;
+  };
+  EXPECT_EQ(populated_rings(), 0);
+
+  std::thread([] { tinylog("claim a ring") }).join();
+  EXPECT_EQ(populated_rings(), 1);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(SharedMemoryTransport, FailedCreateLeavesNothingBehind) {
+  const std::string name = "/log4tiny_failed_create_test_" + std::to_string(getpid());
+  const auto open_descriptors = [] {
+    const std::filesystem::directory_iterator descriptors{"/proc/self/fd"};
+    return std::distance(begin(descriptors), end(descriptors));
+  };
+  const auto descriptors_before = open_descriptors();
+  FailingAllocator allocator{};
+  EXPECT_THROW(shm::Segment::create(name, 4, 4096, shm::QueueKind::spsc, allocator), std::system_error);
+  EXPECT_EQ(open_descriptors(), descriptors_before);
+  EXPECT_FALSE(shm::Segment::open(name));
+  EXPECT_EQ(shm_unlink(name.c_str()), -1);
+}
+
+TEST(AdaptivePoller, SleepingConsumerIsWokenByProducer) {
+  std::atomic<uint32_t> consumer_sleeping{0};
+  AdaptivePoller poller{consumer_sleeping, {.spin_polls = 1, .yield_polls = 1, .max_sleep = std::chrono::seconds(10)}};
+  poller.idle([] { return false; });
+  poller.idle([] { return false; });
+  EXPECT_FALSE(poller.is_spinning());
+
+  std::thread producer([&consumer_sleeping] {
+    while (consumer_sleeping.load() == 0) {
+      std::this_thread::yield();
+    }
+    wake_consumer(consumer_sleeping);
+  });
+  const auto start = std::chrono::steady_clock::now();
+  poller.idle([] { return false; });
+  producer.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  EXPECT_EQ(consumer_sleeping.load(), 0);
+
+  // Records published before consumer declared itself asleep are not slept over
+  const auto again = std::chrono::steady_clock::now();
+  poller.idle([] { return true; });
+  EXPECT_LT(std::chrono::steady_clock::now() - again, std::chrono::seconds(5));
+}
+
+TEST(Backend, DrainsRecordsIntoSink) {
+  const std::string name = "/log4tiny_backend_test_" + std::to_string(getpid());
+  const std::string path = testing::TempDir() + "log4tiny_backend_test.bin";
+  {
+    const auto transport = start_backend(name, std::make_unique<FileSink>(path, 4096, false));
+    EXPECT_TRUE(transport.backend->is_configured());
+    const auto before = transport.backend->collect_statistics();
+    for (int i = 0; i < 100; ++i) {
+      tinylog("record %d", i)
+    }
+    while (transport.backend->collect_statistics().drained_records < before.drained_records + 101) {
+      std::this_thread::yield();
+    }
+    const auto statistics = transport.backend->collect_statistics();
+    EXPECT_EQ(statistics.records_written - before.records_written, 101);
+    EXPECT_GT(statistics.drain_batches, 0);
+    EXPECT_LE(statistics.max_drain_batch_bytes, statistics.drained_bytes);
+  }
+  shm_unlink(name.c_str());
+
+  const decoder::LogFile file{path};
+  size_t log_records{0};
+  file.read_records(sizeof(protocol::FileHeader), file.size(), [&log_records](std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    log_records += header.kind == protocol::RecordKind::log ? 1 : 0;
+  });
+  EXPECT_EQ(log_records, 100);
+}
+
+TEST(Backend, CountsBatchesWrittenWhenFull) {
+  const std::string name = "/log4tiny_backend_full_test_" + std::to_string(getpid());
+  const std::string path = testing::TempDir() + "log4tiny_backend_full_test.bin";
+  {
+    const auto transport = start_backend(name, std::make_unique<FileSink>(path, 4096, false));
+    const auto before = transport.backend->collect_statistics();
+    const uint64_t start = detail::timestamp_now();
+    for (int i = 0; i < 300; ++i) {
+      tinylog("record %d", i)
+    }
+    while (transport.backend->collect_statistics().drained_records < before.drained_records + 301) {
+      std::this_thread::yield();
+    }
+    const auto statistics = transport.backend->collect_statistics();
+    // 300 records do not fit 4096 bytes, batches were written out by the sink before any flush
+    EXPECT_GE(statistics.sink_writes - before.sink_writes, 2);
+    const auto drained = statistics.drained_records - before.drained_records;
+    EXPECT_LE(statistics.total_drain_latency_ns - before.total_drain_latency_ns,
+              drained * (detail::timestamp_now() - start));
+    EXPECT_LE(statistics.max_drain_latency_ns, detail::timestamp_now() - start);
+  }
+  shm_unlink(name.c_str());
+}
+
+TEST(ThreadOptions, ConfigureCurrentThread) {
+  std::thread([] {
+    // Switching to SCHED_IDLE needs no privileges
+    EXPECT_TRUE(configure_current_thread({.cpus = {0}, .scheduling = SchedulingPolicy::idle,
+                                                  .name = "log4tiny-test-thread"}));
+    std::array<char, 16> name{};
+    pthread_getname_np(pthread_self(), name.data(), name.size());
+    EXPECT_STREQ(name.data(), "log4tiny-test-t");
+    EXPECT_EQ(sched_getscheduler(0), SCHED_IDLE);
+    cpu_set_t cpus{};
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+    EXPECT_EQ(CPU_COUNT(&cpus), 1);
+    EXPECT_TRUE(CPU_ISSET(0, &cpus));
+  }).join();
+}
+
+TEST(SiteCounters, ProducerCountsHitsOfEverySite) {
+  static detail::SiteCounter first{0x1234, 10, "first.cpp", "a %d"};
+  static detail::SiteCounter second{0x1234, 20, "first.cpp", "b %d"};
+  for (int i = 0; i < 5; ++i) {
+    first.count(32);
+  }
+  second.count(1000);
+
+  const auto top = top_talkers(site_volumes(), 2);
+  ASSERT_EQ(top.size(), 2);
+  EXPECT_EQ(top.at(0).line, 20);
+  EXPECT_EQ(top.at(1).line, 10);
+  EXPECT_EQ(top.at(1).records, 5);
+  EXPECT_EQ(top.at(1).bytes, 160);
+}
+
+TEST(RateLimiter, BurstThenSteadyRate) {
+  constexpr uint64_t second = 1'000'000'000;
+  RateLimiter limiter{10, 3};
+  const uint64_t start = 1000 * second;
+  uint64_t suppressed{0};
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(limiter.acquire(start, suppressed), 0);
+  }
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_FALSE(limiter.acquire(start + second / 20, suppressed));
+  }
+  EXPECT_EQ(suppressed, 5);
+  // A token per 100 ms, suppressed records are reported by the first allowed one
+  EXPECT_EQ(limiter.acquire(start + second / 10, suppressed), 5);
+  EXPECT_EQ(suppressed, 0);
+  EXPECT_FALSE(limiter.acquire(start + second / 10, suppressed));
+  EXPECT_EQ(limiter.acquire(start + 2 * second / 10, suppressed), 1);
+  // Idle bucket refills up to the burst size only
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(limiter.acquire(start + 100 * second, suppressed), 0);
+  }
+  EXPECT_FALSE(limiter.acquire(start + 100 * second, suppressed));
+}
+
+TEST(SharedMemoryTransport, RateLimitedSiteSuppressesStorm) {
+  const std::string name = "/log4tiny_rate_limit_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+
+  for (int i = 0; i < 1000; ++i) {
+    tinylog_rate_limited(1, 3, "storm %d", i)
+  }
+  size_t log_records{0};
+  shm::drain(*segment, [&log_records](std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    log_records += header.kind == protocol::RecordKind::log ? 1 : 0;
+  });
+  EXPECT_EQ(log_records, 3);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(Sampling, HashDependsOnKeyOnly) {
+  EXPECT_EQ(sampling_hash(42), sampling_hash(uint64_t{42}));
+  EXPECT_EQ(sampling_hash("request-1"), sampling_hash(std::string{"request-1"}));
+  EXPECT_NE(sampling_hash("request-1"), sampling_hash("request-2"));
+  size_t sampled{0};
+  for (uint64_t key = 0; key < 10000; ++key) {
+    sampled += is_sampled(key, 10) ? 1 : 0;
+  }
+  EXPECT_GT(sampled, 900);
+  EXPECT_LT(sampled, 1100);
+}
+
+TEST(SharedMemoryTransport, SampledSitesRecordTheirRate) {
+  const std::string name = "/log4tiny_sampling_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+
+  for (int i = 0; i < 100; ++i) {
+    tinylog_sampled(10, "every tenth %d", i)
+  }
+  size_t by_key{0};
+  for (uint64_t request = 0; request < 100; ++request) {
+    by_key += is_sampled(request, 4) ? 1 : 0;
+    tinylog_sampled_by(4, request, "request %lu", request)
+  }
+
+  decoder::SiteRegistry sites{};
+  std::map<uint32_t, size_t> records_per_site{};
+  shm::drain(*segment, [&](std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (header.kind == protocol::RecordKind::site) {
+      sites.define(record);
+    } else {
+      ++records_per_site[sites.find(header.site_id)->sampling_rate];
+    }
+  });
+  EXPECT_EQ(records_per_site[10], 10);
+  EXPECT_EQ(records_per_site[4], by_key);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(SharedMemoryTransport, ErrorRecordIsPrecededByLastDebugRecords) {
+  const std::string name = "/log4tiny_backtrace_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+  set_backtrace_size(4);
+
+  // Sites are defined once per stream, before their first debug record is buffered
+  decoder::SiteRegistry sites{};
+  const auto drain_formats = [&] {
+    std::vector<std::string> formats{};
+    shm::drain(*segment, [&](std::span<const uint8_t> record) {
+      protocol::RecordHeader header{};
+      std::memcpy(&header, record.data(), sizeof(header));
+      if (header.kind == protocol::RecordKind::site) {
+        sites.define(record);
+      } else {
+        std::vector<protocol::ArgumentValue> arguments{};
+        ASSERT_TRUE(decoder::decode_arguments(*sites.find(header.site_id), record, arguments));
+        formats.push_back(sites.find(header.site_id)->format + std::to_string(arguments[0].signed_int));
+      }
+    });
+    return formats;
+  };
+
+  for (int i = 0; i < 10; ++i) {
+    tinylog_debug("step %d", i)
+  }
+  EXPECT_TRUE(drain_formats().empty());
+
+  tinylog_error("failed %d", 10)
+  EXPECT_EQ(drain_formats(), (std::vector<std::string>{"step %d6", "step %d7", "step %d8", "step %d9", "failed %d10"}));
+
+  tinylog_error("failed %d", 11)
+  EXPECT_EQ(drain_formats(), (std::vector<std::string>{"failed %d11"}));
+
+  set_backtrace_size(0);
+  tinylog_debug("step %d", 12)
+  tinylog_error("failed %d", 13)
+  EXPECT_EQ(drain_formats(), (std::vector<std::string>{"failed %d13"}));
+
+  set_backtrace_size(32);
+  source.reset();
+  shm_unlink(name.c_str());
+}
+
+TEST(SharedMemoryTransport, XorCodedFloatsAreDecodedByStream) {
+  const std::string name = "/log4tiny_xor_floats_test_" + std::to_string(getpid());
+  auto source = shm::attach(name, 4, 1U << 16);
+  auto segment = shm::Segment::open(name);
+  ASSERT_TRUE(segment);
+
+  constexpr int count = 100;
+  const auto price = [](const int i) { return 100.0 + (i % 4) * 0.25; };
+  for (int i = 0; i < count; ++i) {
+    tinylog_xor_floats("price %f qty %d latency %f", price(i), i, 5.5)
+    tinylog("price %f qty %d latency %f", price(i), i, 5.5)
+  }
+  std::vector<std::vector<uint8_t>> records{};
+  shm::drain(*segment, [&records](std::span<const uint8_t> record) { records.emplace_back(record.begin(), record.end()); });
+
+  decoder::SiteRegistry sites{};
+  decoder::FloatStreams streams{};
+  std::vector<double> values{};
+  std::vector<protocol::ArgumentValue> arguments{};
+  std::map<bool, size_t> bytes_by_coding{};
+  std::vector<std::vector<uint8_t>> xor_records{};
+  int xor_index{0};
+  for (const auto &record: records) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (header.kind == protocol::RecordKind::site) {
+      sites.define(record);
+      continue;
+    }
+    const auto &site = *sites.find(header.site_id);
+    const bool xor_coded = not site.xor_coded.empty();
+    bytes_by_coding[xor_coded] += record.size();
+    if (xor_coded) {
+      EXPECT_EQ(site.xor_coded, (std::vector{true, false, true}));
+      ASSERT_TRUE(streams.decode(header, site, record, values));
+      xor_records.push_back(record);
+    }
+    ASSERT_TRUE(decoder::decode_arguments(site, record, arguments, values));
+    ASSERT_EQ(arguments.size(), 3);
+    EXPECT_EQ(arguments[0].type, protocol::ArgumentType::floating);
+    if (xor_coded) {
+      EXPECT_EQ(arguments[0].floating, price(xor_index));
+      EXPECT_EQ(arguments[1].signed_int, xor_index);
+      EXPECT_EQ(arguments[2].floating, 5.5);
+      ++xor_index;
+    }
+  }
+  EXPECT_EQ(xor_index, count);
+  EXPECT_LT(bytes_by_coding[true], bytes_by_coding[false]);
+
+  // Once a record is lost, values of its stream are unknown until the next key record
+  decoder::FloatStreams lossy_streams{};
+  const auto prefix_of = [](const std::vector<uint8_t> &record) {
+    protocol::XorStreamPrefix prefix{};
+    std::memcpy(&prefix, record.data() + sizeof(protocol::RecordHeader), sizeof(prefix));
+    return prefix;
+  };
+  std::optional<uint16_t> lost_stream{};
+  bool recovered{false};
+  for (const auto &record: xor_records) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    const auto prefix = prefix_of(record);
+    if (not lost_stream and prefix.sequence == 1) {
+      lost_stream = prefix.stream;
+      continue;
+    }
+    recovered = recovered or (lost_stream == prefix.stream and prefix.sequence == 0);
+    EXPECT_EQ(lossy_streams.decode(header, *sites.find(header.site_id), record, values),
+              lost_stream != prefix.stream or recovered);
+  }
+  EXPECT_TRUE(recovered);
+
+  source.reset();
+  shm_unlink(name.c_str());
+}
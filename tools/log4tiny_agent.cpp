@@ -0,0 +1,234 @@
+// Out-of-process agent draining shared memory segment of a producer into binary log file or local socket.
+// Usage: log4tiny_agent [--per-node] [--cpus <list>] [--sched fifo[:<priority>] | idle] <segment name>
+//                       <output file | unix:<socket path> | unix-seqpacket:<socket path>>
+// Agent waits for the segment to appear, drains rings of all slots and follows the producer when it recreates the
+// segment (e.g. after restart). While records are flowing, agent polls the rings continuously, otherwise it sleeps
+// until a producer wakes it (see AdaptivePoller). SIGINT/SIGTERM make the agent drain what is left and exit.
+// With --per-node, agent runs one draining thread per NUMA node, pinned to CPUs of the node. Every thread drains only
+// rings placed on its node and writes to its own output, named after the given one with ".node<N>" suffix. Every
+// output is a complete binary log of the threads that wrote to rings of the node.
+// --cpus (e.g. "2-3,6") restricts draining threads to given CPUs, overriding placement by --per-node, and --sched sets
+// their scheduling policy (see SchedulingPolicy). Threads are named "log4tiny-agent" or "log4tiny-node<N>".
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sched.h>
+#include <numa.hpp>
+#include <polling.hpp>
+#include <shm_transport.hpp>
+#include <sink.hpp>
+#include <thread_options.hpp>
+#include <unix_socket_sink.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+constexpr std::string_view stream_socket_prefix = "unix:";
+constexpr std::string_view seqpacket_socket_prefix = "unix-seqpacket:";
+
+std::atomic<bool> stop_requested{false};
+
+void request_stop(int) {
+  stop_requested.store(true);
+}
+
+std::unique_ptr<Sink> make_sink(const std::string &output) {
+  if (output.starts_with(stream_socket_prefix)) {
+    return std::make_unique<UnixSocketSink>(output.substr(stream_socket_prefix.size()), SocketType::stream);
+  }
+  if (output.starts_with(seqpacket_socket_prefix)) {
+    return std::make_unique<UnixSocketSink>(output.substr(seqpacket_socket_prefix.size()), SocketType::seqpacket);
+  }
+  return std::make_unique<FileSink>(output);
+}
+
+std::optional<shm::Segment> wait_for_segment(const std::string &name) {
+  while (not stop_requested.load()) {
+    if (auto segment = shm::Segment::open(name)) {
+      return segment;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return std::nullopt;
+}
+
+struct Arguments {
+  bool per_node{false};
+  ThreadOptions thread{};
+  std::string segment_name{};
+  std::string output_name{};
+};
+
+std::optional<SchedulingPolicy> parse_scheduling(const std::string_view policy, int &priority) {
+  if (policy == "idle") {
+    return SchedulingPolicy::idle;
+  }
+  if (policy == "fifo") {
+    return SchedulingPolicy::fifo;
+  }
+  if (policy.starts_with("fifo:")) {
+    const auto value = policy.substr(5);
+    if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), priority);
+            error != std::errc{} or end != value.data() + value.size()) {
+      return std::nullopt;
+    }
+    return SchedulingPolicy::fifo;
+  }
+  return std::nullopt;
+}
+
+// Parse CPU list such as "2-3,6". Unlike numa::parse_list(), which reads what sysfs reports, anything malformed is
+// rejected, as are CPUs past CPU_SETSIZE, so that a typo does not leave draining threads unpinned
+std::optional<std::vector<unsigned>> parse_cpus(std::string_view list) {
+  std::vector<unsigned> cpus{};
+  while (true) {
+    const auto item = list.substr(0, list.find(','));
+    const auto dash = item.find('-');
+    const auto first_text = item.substr(0, dash);
+    const auto last_text = dash == std::string_view::npos ? first_text : item.substr(dash + 1);
+    unsigned first{0};
+    unsigned last{0};
+    if (const auto [end, error] = std::from_chars(first_text.data(), first_text.data() + first_text.size(), first);
+            error != std::errc{} or end != first_text.data() + first_text.size()) {
+      return std::nullopt;
+    }
+    if (const auto [end, error] = std::from_chars(last_text.data(), last_text.data() + last_text.size(), last);
+            error != std::errc{} or end != last_text.data() + last_text.size() or last < first or last >= CPU_SETSIZE) {
+      return std::nullopt;
+    }
+    for (unsigned cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    if (item.size() == list.size()) {
+      return cpus;
+    }
+    list.remove_prefix(item.size() + 1);
+  }
+}
+
+std::optional<Arguments> parse_arguments(const int argc, char **argv) {
+  Arguments arguments{};
+  std::vector<std::string> positional{};
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view argument{argv[index]};
+    if (argument == "--per-node") {
+      arguments.per_node = true;
+    } else if (argument == "--cpus" and index + 1 < argc) {
+      auto cpus = parse_cpus(argv[++index]);
+      if (not cpus) {
+        return std::nullopt;
+      }
+      arguments.thread.cpus = std::move(*cpus);
+    } else if (argument == "--sched" and index + 1 < argc) {
+      const auto policy = parse_scheduling(argv[++index], arguments.thread.fifo_priority);
+      if (not policy) {
+        return std::nullopt;
+      }
+      arguments.thread.scheduling = *policy;
+    } else {
+      positional.emplace_back(argument);
+    }
+  }
+  if (positional.size() != 2) {
+    return std::nullopt;
+  }
+  arguments.segment_name = std::move(positional[0]);
+  arguments.output_name = std::move(positional[1]);
+  return arguments;
+}
+
+// Drain rings (of given NUMA node only, if any) into the output until stop is requested
+void run(const std::string &segment_name, const std::string &output_name, const std::optional<int> node,
+         ThreadOptions thread) {
+  if (node and thread.cpus.empty() and not numa::pin_thread_to_node(*node)) {
+    std::fprintf(stderr, "log4tiny_agent: could not pin thread to node %d\n", *node);
+  }
+  thread.name = node ? "log4tiny-node" + std::to_string(*node) : "log4tiny-agent";
+  if (not configure_current_thread(thread)) {
+    std::fprintf(stderr, "log4tiny_agent: could not apply CPU or scheduling options\n");
+  }
+  const auto output = make_sink(output_name);
+  auto segment = wait_for_segment(segment_name);
+  if (not segment) {
+    return;
+  }
+  auto poller = std::make_unique<AdaptivePoller>(segment->header()->consumer_sleeping);
+  auto idle_since = std::chrono::steady_clock::now();
+  while (true) {
+    if (shm::drain(*segment, [&output](std::span<const uint8_t> record) { output->write(record); }, node) != 0) {
+      poller->reset();
+      idle_since = std::chrono::steady_clock::now();
+      continue;
+    }
+    if (stop_requested.load()) {
+      break;
+    }
+    if (not poller->is_spinning()) {
+      output->flush();
+    }
+
+    // When idle for a while, check whether producer has replaced the segment. Old one is already fully drained
+    if (std::chrono::steady_clock::now() - idle_since > std::chrono::seconds(1)) {
+      if (auto current = shm::Segment::open(segment_name); current and current->inode() != segment->inode()) {
+        segment = std::move(current);
+        poller = std::make_unique<AdaptivePoller>(segment->header()->consumer_sleeping);
+      }
+      idle_since = std::chrono::steady_clock::now();
+    }
+    poller->idle([&] { return stop_requested.load() or shm::has_records(*segment); });
+  }
+  output->flush();
+}
+
+}
+
+int main(int argc, char **argv) {
+  const auto arguments = parse_arguments(argc, argv);
+  if (not arguments) {
+    std::fprintf(stderr, "Usage: %s [--per-node] [--cpus <list>] [--sched fifo[:<priority>] | idle] <segment name> "
+                         "<output file | unix:<socket path> | unix-seqpacket:<socket path>>\n", argv[0]);
+    return 1;
+  }
+  const auto &[per_node, thread, segment_name, output_name] = *arguments;
+  std::signal(SIGINT, request_stop);
+  std::signal(SIGTERM, request_stop);
+
+  if (not per_node) {
+    try {
+      run(segment_name, output_name, std::nullopt, thread);
+    } catch (const std::exception &exception) {
+      std::fprintf(stderr, "log4tiny_agent: %s\n", exception.what());
+      return 1;
+    }
+    return 0;
+  }
+
+  std::atomic<bool> failed{false};
+  std::vector<std::thread> threads{};
+  for (int node = 0; node < numa::node_count(); ++node) {
+    threads.emplace_back([&, node] {
+      try {
+        run(segment_name, output_name + ".node" + std::to_string(node), node, thread);
+      } catch (const std::exception &exception) {
+        std::fprintf(stderr, "log4tiny_agent: node %d: %s\n", node, exception.what());
+        failed.store(true);
+        stop_requested.store(true);
+      }
+    });
+  }
+  for (auto &thread: threads) {
+    thread.join();
+  }
+  return failed.load() ? 1 : 0;
+}
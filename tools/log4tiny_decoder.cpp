@@ -0,0 +1,327 @@
+// Decoder of binary logs written by FileSink (or log4tiny_receiver).
+// Usage: log4tiny_decoder [options] <binary log>
+// --from <time>, --to <time>  - select time range. Time is given either as nanoseconds since epoch or as UTC
+//                               "YYYY-MM-DDTHH:MM:SS[.fraction]". When sidecar index is present, only chunks that may
+//                               hold records of the requested time range are read.
+// --site <id>                 - select records of given call site (see --sites)
+// --file <path>               - select records logged from given file, path as seen by the compiler in __FILE__
+// --file-hash <hash>          - select records logged from file with given CRC32 hash of its path
+// --format <substring>        - select records whose format string contains given substring
+// --where <predicate>         - select records by argument value, e.g. "arg0 > 500" or "arg1 == text". May be repeated
+// --sites                     - list call sites instead of records
+// --top-talkers <count>       - list call sites producing the most bytes of selected records instead of records
+// --structured                - render records as fields: msg="<message>" followed by name=value for every placeholder,
+//                               named in the format (e.g. "%{order_id}u") or by argument index (arg<index>)
+// --json                      - render records as JSON Lines, one object per record with timestamp, thread, level,
+//                               file, line, format, message and typed arguments keyed by field names
+// --columns <directory>       - export selected records into column files, a directory per call site with a column
+//                               per placeholder (format is described in column_export.hpp)
+// Sampled sites are listed with their sampling rate ("sampled 1/<rate>") - their records stand for rate calls each.
+// Selection is done on binary records, only selected records are rendered to text.
+// Floating point values of sites logged with tinylog_xor_floats depend on the previous records of their thread, when
+// chunks are skipped by --from, they are unknown until the next key record of the thread (see protocol::XorStreamPrefix).
+// Values of user types (see codec.hpp) are rendered as their bytes in hex, as this decoder has no renderers registered -
+// decoders built with the logged types call register_codec<T>() before reading the log.
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <column_export.hpp>
+#include <decoder.hpp>
+#include <json_output.hpp>
+#include <record_filter.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+struct Options {
+  std::string path;
+  uint64_t from{0};
+  uint64_t to{std::numeric_limits<uint64_t>::max()};
+  decoder::RecordFilter filter{};
+  bool list_sites{false};
+  std::optional<size_t> top_talkers{};
+  bool structured{false};
+  bool json{false};
+  std::optional<std::string> columns_directory{};
+};
+
+template<typename T>
+std::optional<T> parse_number(const std::string_view text, const int base = 10) {
+  T value{};
+  if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+          error != std::errc{} or end != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> parse_options(const int argc, char **argv) {
+  Options options{};
+  for (int argument = 1; argument < argc; ++argument) {
+    const std::string_view name = argv[argument];
+    if ((name == "--from" or name == "--to") and argument + 1 < argc) {
+      const auto timestamp = decoder::parse_timestamp(argv[++argument]);
+      if (not timestamp) {
+        return std::nullopt;
+      }
+      (name == "--from" ? options.from : options.to) = *timestamp;
+    } else if (name == "--site" and argument + 1 < argc) {
+      options.filter.site_id = parse_number<uint32_t>(argv[++argument]);
+      if (not options.filter.site_id) {
+        return std::nullopt;
+      }
+    } else if (name == "--file" and argument + 1 < argc) {
+      options.filter.file_hash = decoder::RecordFilter::hash_file(argv[++argument]);
+    } else if (name == "--file-hash" and argument + 1 < argc) {
+      const std::string_view hash = argv[++argument];
+      options.filter.file_hash = hash.starts_with("0x") ? parse_number<uint32_t>(hash.substr(2), 16)
+                                                        : parse_number<uint32_t>(hash);
+      if (not options.filter.file_hash) {
+        return std::nullopt;
+      }
+    } else if (name == "--format" and argument + 1 < argc) {
+      options.filter.format_substring = argv[++argument];
+    } else if (name == "--where" and argument + 1 < argc) {
+      auto predicate = decoder::parse_argument_predicate(argv[++argument]);
+      if (not predicate) {
+        return std::nullopt;
+      }
+      options.filter.argument_predicates.push_back(std::move(*predicate));
+    } else if (name == "--sites") {
+      options.list_sites = true;
+    } else if (name == "--top-talkers" and argument + 1 < argc) {
+      options.top_talkers = parse_number<size_t>(argv[++argument]);
+      if (not options.top_talkers) {
+        return std::nullopt;
+      }
+    } else if (name == "--structured") {
+      options.structured = true;
+    } else if (name == "--json") {
+      options.json = true;
+    } else if (name == "--columns" and argument + 1 < argc) {
+      options.columns_directory = argv[++argument];
+    } else if (options.path.empty() and not name.starts_with("--")) {
+      options.path = name;
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (options.path.empty()) {
+    return std::nullopt;
+  }
+  return options;
+}
+
+std::string sampling_mark(const uint32_t sampling_rate) {
+  return sampling_rate > 1 ? " sampled 1/" + std::to_string(sampling_rate) : std::string{};
+}
+
+class Printer {
+public:
+  explicit Printer(Options &options) : options(options) {
+    if (options.columns_directory) {
+      exporter = std::make_unique<columns::ColumnExporter>(*options.columns_directory);
+    }
+  }
+
+  void operator()(std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    if (header.kind == protocol::RecordKind::site) {
+      define_site(record);
+      return;
+    }
+    if (header.kind != protocol::RecordKind::log or options.list_sites) {
+      return;
+    }
+
+    const auto *site = sites.find(header.site_id);
+    // XOR coded values depend on the previous record of the stream, so they are decoded even when record is not selected
+    xor_values_known = site == nullptr or site->xor_coded.empty() or
+                       float_streams.decode(header, *site, record, xor_values);
+    if (header.timestamp < options.from or header.timestamp > options.to) {
+      return;
+    }
+    if (not options.filter.is_empty() and
+        (site == nullptr or not options.filter.matches(header, *site, record, xor_values))) {
+      return;
+    }
+    if (options.top_talkers) {
+      if (site != nullptr) {
+        volumes.add(*site, record.size());
+      }
+      return;
+    }
+    if (exporter) {
+      if (site != nullptr and decoder::decode_arguments(*site, record, arguments, xor_values)) {
+        exporter->add(header, *site, arguments);
+      }
+      return;
+    }
+
+    line.clear();
+    if (options.json) {
+      print_json(header, site, record);
+      return;
+    }
+    decoder::format_timestamp(line, header.timestamp);
+    if (site == nullptr) {
+      line += " <unknown call site " + std::to_string(header.site_id) + ">\n";
+      std::fputs(line.c_str(), stdout);
+      return;
+    }
+    line += " [" + std::to_string(header.thread_id) + "] " + site->file + ":" + std::to_string(site->line) + " ";
+    if (not xor_values_known) {
+      line += "<floating point values lost with an earlier record>";
+    } else if (not decoder::decode_arguments(*site, record, arguments, xor_values)) {
+      line += "<corrupted record>";
+    } else if (options.structured) {
+      line += "msg=";
+      const auto message_offset = line.size();
+      site->program.render(line, arguments);
+      decoder::quote_field_value(line, message_offset);
+      if (not site->program.get_field_names().empty()) {
+        line.push_back(' ');
+        site->program.render_fields(line, arguments);
+      }
+    } else {
+      site->program.render(line, arguments);
+    }
+    line.push_back('\n');
+    std::fwrite(line.data(), 1, line.size(), stdout);
+  }
+
+  // Records that cannot be decoded are reported as objects with "error" instead of record fields
+  void print_json(const protocol::RecordHeader &header, const decoder::SiteInfo *site, std::span<const uint8_t> record) {
+    if (site != nullptr and xor_values_known and decoder::decode_arguments(*site, record, arguments, xor_values)) {
+      json::append_record(line, header, *site, arguments);
+    } else {
+      line += "{\"timestamp\":";
+      json::append_unsigned(line, header.timestamp);
+      line += ",\"thread\":";
+      json::append_unsigned(line, header.thread_id);
+      line += ",\"site\":";
+      json::append_unsigned(line, header.site_id);
+      line += site == nullptr ? ",\"error\":\"unknown call site\"}"
+              : not xor_values_known ? ",\"error\":\"floating point values lost with an earlier record\"}"
+              : ",\"error\":\"corrupted record\"}";
+    }
+    line.push_back('\n');
+    std::fwrite(line.data(), 1, line.size(), stdout);
+  }
+
+  void define_site(std::span<const uint8_t> record) {
+    protocol::RecordHeader header{};
+    std::memcpy(&header, record.data(), sizeof(header));
+    sites.define(record);
+    options.filter.forget_site(header.site_id);
+    float_streams.forget_site(header.site_id);
+    if (exporter) {
+      exporter->forget_site(header.site_id);
+    }
+  }
+
+  void print_sites() const {
+    std::vector<std::pair<uint32_t, const decoder::SiteInfo *>> sorted_sites{};
+    for (const auto &[id, site]: sites.get_sites()) {
+      sorted_sites.emplace_back(id, &site);
+    }
+    std::ranges::sort(sorted_sites);
+    for (const auto &[id, site]: sorted_sites) {
+      std::printf("%u 0x%08x %s:%u \"%s\"%s\n", id, site->file_hash, site->file.c_str(), site->line,
+                  site->format.c_str(), sampling_mark(site->sampling_rate).c_str());
+    }
+  }
+
+  void print_top_talkers() const {
+    const auto all = volumes.get_volumes();
+    uint64_t total_bytes{0};
+    for (const auto &volume: all) {
+      total_bytes += volume.bytes;
+    }
+    std::printf("%12s %14s %6s  site\n", "records", "bytes", "share");
+    for (const auto &volume: top_talkers(all, *options.top_talkers)) {
+      std::printf("%12llu %14llu %5.1f%%  0x%08x %s:%u \"%s\"%s\n", static_cast<unsigned long long>(volume.records),
+                  static_cast<unsigned long long>(volume.bytes),
+                  100.0 * static_cast<double>(volume.bytes) / static_cast<double>(total_bytes), volume.file_hash,
+                  volume.file.c_str(), volume.line, volume.format.c_str(), sampling_mark(volume.sampling_rate).c_str());
+    }
+  }
+
+  void finish_export() {
+    if (exporter) {
+      exporter->finish();
+    }
+  }
+
+  decoder::SiteRegistry sites{};
+
+private:
+  Options &options;
+  std::string line{};
+  std::vector<protocol::ArgumentValue> arguments{};
+  decoder::FloatStreams float_streams{};
+  std::vector<double> xor_values{};
+  bool xor_values_known{true};
+  decoder::VolumeCounter volumes{};
+  std::unique_ptr<columns::ColumnExporter> exporter{};
+};
+
+}
+
+int main(int argc, char **argv) {
+  auto options = parse_options(argc, argv);
+  if (not options) {
+    std::fprintf(stderr, "Usage: %s [--from <time>] [--to <time>] [--site <id>] [--file <path>] [--file-hash <hash>] "
+                         "[--format <substring>] [--where <predicate>]... [--sites | --top-talkers <count>] "
+                         "[--structured | --json | --columns <directory>] <binary log>\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    const decoder::LogFile file{options->path};
+    Printer printer{*options};
+    uint64_t unindexed_begin = sizeof(protocol::FileHeader);
+
+    if (auto index = file.load_index()) {
+      // Walk sidecar up to the last selected chunk, so that site definitions from skipped chunks are known
+      const auto [first, last] = index->find_chunks(options->from, options->to);
+      const auto &chunks = index->get_chunks();
+      const auto sidecar_end = last < chunks.size() ? chunks[last].sidecar_offset : index->get_records().size();
+      size_t chunk{0};
+      protocol::for_each_record(index->get_records().first(sidecar_end), [&](std::span<const uint8_t> record) {
+        protocol::RecordHeader header{};
+        std::memcpy(&header, record.data(), sizeof(header));
+        if (header.kind == protocol::RecordKind::site) {
+          printer.define_site(record);
+        } else if (header.kind == protocol::RecordKind::chunk_index) {
+          if (chunk >= first) {
+            const auto &entry = chunks[chunk].entry;
+            file.read_records(entry.offset, entry.offset + entry.length, std::ref(printer));
+          }
+          ++chunk;
+        }
+      });
+      unindexed_begin = std::max(unindexed_begin, index->indexed_end());
+    }
+
+    // Part of the log written after the index was last updated (or the whole log when there is no index)
+    file.read_records(unindexed_begin, file.size(), std::ref(printer));
+    if (options->list_sites) {
+      printer.print_sites();
+    } else if (options->top_talkers) {
+      printer.print_top_talkers();
+    }
+    printer.finish_export();
+  } catch (const std::exception &exception) {
+    std::fprintf(stderr, "log4tiny_decoder: %s\n", exception.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Minimal local collector for UnixSocketSink, intended for testing. Accepts connections one after another and stores
+// received records in a binary log file that can be read the same way as a file written by FileSink.
+// Usage: log4tiny_receiver <socket path> <output file> [--seqpacket]
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sink.hpp>
+#include <unix_socket_sink.hpp>
+
+using namespace log4tiny;
+
+namespace {
+
+int listen_on(const std::string &path, const SocketType type) {
+  const int fd = ::socket(AF_UNIX, static_cast<int>(type) | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 or ::listen(fd, 1) != 0) {
+    throw std::system_error(errno, std::generic_category(), "bind " + path);
+  }
+  return fd;
+}
+
+// Copy stream of one connection to output, skipping its file header. Returns number of record bytes received
+size_t receive_connection(const int connection, const int output) {
+  std::vector<uint8_t> buffer(1U << 20);
+  size_t header_bytes_left = sizeof(protocol::FileHeader);
+  size_t received{0};
+  while (true) {
+    const auto length = ::recv(connection, buffer.data(), buffer.size(), 0);
+    if (length < 0 and errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return received;
+    }
+    std::span<const uint8_t> bytes{buffer.data(), static_cast<size_t>(length)};
+    const auto skipped = std::min(header_bytes_left, bytes.size());
+    header_bytes_left -= skipped;
+    bytes = bytes.subspan(skipped);
+    write_all(output, bytes);
+    received += bytes.size();
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3 or argc > 4 or (argc == 4 and std::string{argv[3]} != "--seqpacket")) {
+    std::fprintf(stderr, "Usage: %s <socket path> <output file> [--seqpacket]\n", argv[0]);
+    return 1;
+  }
+  const auto type = argc == 4 ? SocketType::seqpacket : SocketType::stream;
+
+  try {
+    const int listener = listen_on(argv[1], type);
+    const int output = ::open(argv[2], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output < 0) {
+      throw std::system_error(errno, std::generic_category(), std::string{"open "} + argv[2]);
+    }
+    write_all(output, file_header_bytes());
+    while (true) {
+      const int connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (connection < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "accept");
+      }
+      const auto received = receive_connection(connection, output);
+      ::close(connection);
+      std::fprintf(stderr, "log4tiny_receiver: connection closed, %zu bytes of records received\n", received);
+    }
+  } catch (const std::exception &exception) {
+    std::fprintf(stderr, "log4tiny_receiver: %s\n", exception.what());
+    return 1;
+  }
+}